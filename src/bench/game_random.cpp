@@ -0,0 +1,25 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <game/common.h>
+#include <uint256.h>
+
+#include <cassert>
+
+// Draws as done for spawning characters and placing hearts.
+static void GameRandom(benchmark::State& state)
+{
+    RandomGenerator rnd(uint256S("4bf3a4e732a8ef2c8d93c996f9ffc9e8c9044ec687b13defb9b86cd33b7428e2"));
+    uint64_t sum = 0;
+    while (state.KeepRunning()) {
+        sum += rnd.GetIntRnd(502);
+        sum += rnd.GetIntRnd(2);
+        sum += rnd.GetIntRnd(0, 99);
+    }
+    assert(sum > 0);
+}
+
+BENCHMARK(GameRandom, 2 * 1000 * 1000);
@@ -6,13 +6,16 @@
 
 #include <consensus/consensus.h>
 #include <random.h>
+#include <util.h>
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::GetName(const valtype &name, CNameData &data) const { return false; }
-bool CCoinsView::GetNameHistory(const valtype &name, CNameHistory &data) const { return false; }
+unsigned CCoinsView::GetNameHistorySize(const valtype &name) const { return 0; }
+bool CCoinsView::GetNameHistoryEntry(const valtype &name, unsigned index, CNameData &data) const { return false; }
 CNameIterator* CCoinsView::IterateNames() const { assert (false); }
+CNameIterator* CCoinsView::IterateNamesSnapshot() const { assert (false); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 bool CCoinsView::ValidateNameDB(CGameDB& gameDb) const { return false; }
@@ -23,14 +26,34 @@ bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
     return GetCoin(outpoint, coin);
 }
 
+bool CCoinsView::GetNameHistory(const valtype &name, CNameHistory &data) const
+{
+    const unsigned size = GetNameHistorySize(name);
+    if (size == 0)
+        return false;
+
+    data = CNameHistory();
+    for (unsigned i = 0; i < size; ++i) {
+        CNameData entry;
+        if (!GetNameHistoryEntry(name, i, entry))
+            return error("%s : history entry %u of name '%s' is missing",
+                         __func__, i, ValtypeToString(name).c_str());
+        data.push(entry);
+    }
+
+    return true;
+}
+
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) { }
 bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, Coin &coin) const { return base->GetCoin(outpoint, coin); }
 bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->HaveCoin(outpoint); }
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 bool CCoinsViewBacked::GetName(const valtype &name, CNameData &data) const { return base->GetName(name, data); }
-bool CCoinsViewBacked::GetNameHistory(const valtype &name, CNameHistory &data) const { return base->GetNameHistory(name, data); }
+unsigned CCoinsViewBacked::GetNameHistorySize(const valtype &name) const { return base->GetNameHistorySize(name); }
+bool CCoinsViewBacked::GetNameHistoryEntry(const valtype &name, unsigned index, CNameData &data) const { return base->GetNameHistoryEntry(name, index, data); }
 CNameIterator* CCoinsViewBacked::IterateNames() const { return base->IterateNames(); }
+CNameIterator* CCoinsViewBacked::IterateNamesSnapshot() const { return base->IterateNamesSnapshot(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return base->BatchWrite(mapCoins, hashBlock, names); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
@@ -163,20 +186,32 @@ bool CCoinsViewCache::GetName(const valtype &name, CNameData& data) const {
     return base->GetName(name, data);
 }
 
-bool CCoinsViewCache::GetNameHistory(const valtype &name, CNameHistory& data) const {
-    if (cacheNames.getHistory(name, data))
-        return true;
+unsigned CCoinsViewCache::GetNameHistorySize(const valtype &name) const {
+    unsigned size;
+    if (cacheNames.getHistorySize(name, size))
+        return size;
 
     /* Note: This does not attempt to cache backend queries.  The cache
        only keeps track of changes!  */
 
-    return base->GetNameHistory(name, data);
+    return base->GetNameHistorySize(name);
+}
+
+bool CCoinsViewCache::GetNameHistoryEntry(const valtype &name, unsigned index, CNameData& data) const {
+    if (cacheNames.getHistoryEntry(name, index, data))
+        return true;
+
+    return base->GetNameHistoryEntry(name, index, data);
 }
 
 CNameIterator* CCoinsViewCache::IterateNames() const {
     return cacheNames.iterateNames(base->IterateNames());
 }
 
+CNameIterator* CCoinsViewCache::IterateNamesSnapshot() const {
+    return cacheNames.iterateNamesSnapshot(base->IterateNamesSnapshot());
+}
+
 /* undo is set if the change is due to disconnecting blocks / going back in
    time.  The ordinary case (!undo) means that we update the name normally,
    going forward in time.  This is important for keeping track of the
@@ -190,23 +225,25 @@ void CCoinsViewCache::SetName(const valtype &name, const CNameData& data, bool u
            are not undoing, push the overwritten data onto the history stack.
            Note that we only have to do this if the name already existed
            in the database.  Otherwise, no special action is required
-           for the name history.  */
+           for the name history.  Only the top entry is touched, so this
+           does not depend on the total size of the history.  */
         if (fNameHistory)
         {
-            CNameHistory history;
-            if (!GetNameHistory(name, history))
-            {
-                /* Ensure that the history stack is indeed (still) empty
-                   and was not modified by the failing GetNameHistory call.  */
-                assert(history.empty());
-            }
+            const unsigned size = GetNameHistorySize(name);
+            CNameData top;
+            const bool haveTop = (size > 0 && GetNameHistoryEntry(name, size - 1, top));
+            assert(haveTop == (size > 0));
 
             if (undo)
-                history.pop(data);
+            {
+                assert(haveTop && top == data);
+                cacheNames.popHistory(name, size);
+            }
             else
-                history.push(oldData);
-
-            cacheNames.setHistory(name, history);
+            {
+                assert(!haveTop || top.getHeight() <= oldData.getHeight());
+                cacheNames.pushHistory(name, size, oldData);
+            }
         }
     } else
         assert (!undo);
@@ -218,8 +255,7 @@ void CCoinsViewCache::DeleteName(const valtype &name) {
     if (fNameHistory)
     {
         /* When deleting a name, the history should already be clean.  */
-        CNameHistory history;
-        assert (!GetNameHistory(name, history) || history.empty());
+        assert (GetNameHistorySize(name) == 0);
     }
 
     cacheNames.remove(name);
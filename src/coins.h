@@ -177,12 +177,24 @@ public:
     // Get a name (if it exists)
     virtual bool GetName(const valtype& name, CNameData& data) const;
 
-    // Get a name's history (if it exists)
-    virtual bool GetNameHistory(const valtype& name, CNameHistory& data) const;
+    // Get the size of a name's history stack (0 if there is none)
+    virtual unsigned GetNameHistorySize(const valtype& name) const;
+
+    // Get a single entry of a name's history stack
+    virtual bool GetNameHistoryEntry(const valtype& name, unsigned index, CNameData& data) const;
+
+    // Get a name's full history (if it exists).  This reads all entries
+    // of the history stack individually.
+    bool GetNameHistory(const valtype& name, CNameHistory& data) const;
 
     // Get a name iterator.
     virtual CNameIterator* IterateNames() const;
 
+    // Get a name iterator over a frozen snapshot of the current state.  It is
+    // not affected by later changes to the view (or its backing views), so
+    // it can be used without holding cs_main after creating it.
+    virtual CNameIterator* IterateNamesSnapshot() const;
+
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names);
@@ -214,8 +226,10 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool GetName(const valtype& name, CNameData& data) const override;
-    bool GetNameHistory(const valtype& name, CNameHistory& data) const override;
+    unsigned GetNameHistorySize(const valtype& name) const override;
+    bool GetNameHistoryEntry(const valtype& name, unsigned index, CNameData& data) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesSnapshot() const override;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
     CCoinsViewCursor *Cursor() const override;
@@ -256,8 +270,10 @@ public:
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
     bool GetName(const valtype &name, CNameData &data) const override;
-    bool GetNameHistory(const valtype &name, CNameHistory &data) const override;
+    unsigned GetNameHistorySize(const valtype &name) const override;
+    bool GetNameHistoryEntry(const valtype &name, unsigned index, CNameData &data) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesSnapshot() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names);
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
@@ -267,6 +283,9 @@ public:
     void SetName(const valtype &name, const CNameData &data, bool undo);
     void DeleteName(const valtype &name);
 
+    /* Access the name changes cached in this view.  */
+    const CNameCache& GetNameCache() const { return cacheNames; }
+
     /**
      * Check if we have the given utxo already loaded in this cache.
      * The semantics are the same as HaveCoin(), but no calls to
@@ -15,9 +15,13 @@
 
 #include <game/common.h>
 
+#include <crypto/common.h>
 #include <hash.h>
 #include <names/common.h>
 #include <tinyformat.h>
+#include <utilstrencodings.h>
+
+#include <cstring>
 
 std::string CharacterID::ToString() const
 {
@@ -26,42 +30,96 @@ std::string CharacterID::ToString() const
     return player + strprintf(".%d", int(index));
 }
 
+bool CharacterID::FromString(const std::string &str)
+{
+    /* Player names cannot contain dots, so anything after the last
+       dot must be the character index.  */
+    const size_t pos = str.rfind('.');
+    if (pos == std::string::npos)
+    {
+        player = str;
+        index = 0;
+        return !player.empty();
+    }
+
+    int32_t n;
+    if (!ParseInt32(str.substr(pos + 1), &n) || n <= 0)
+        return false;
+
+    player = str.substr(0, pos);
+    index = n;
+    return !player.empty();
+}
+
 RandomGenerator::RandomGenerator (const uint256& hashBlock)
   : state0(SerializeHash (hashBlock, SER_GETHASH, 0))
 {
-    state = UintToArith256 (state0);
+  LoadState ();
+}
+
+void
+RandomGenerator::LoadState ()
+{
+  for (int i = 0; i < LIMBS; ++i)
+    state[i] = ReadLE32 (state0.begin () + 4 * i);
+}
+
+void
+RandomGenerator::Reseed ()
+{
+  /* The original "legacy" implementation based on CBigNum serialised
+     the value based on valtype and with leading zeros removed.  For
+     compatibility with the old consensus behaviour, we replicate this.
+     The legacy representation uses the highest bit as sign bit.  Thus
+     we have to add a zero at the end if the highest bit is set.
+
+     The serialised valtype (with its length as one-byte CompactSize)
+     is built in a fixed buffer, to avoid any allocations.  */
+  unsigned char data[1 + 256 / 8 + 1];
+  size_t len = state0.size ();
+  while (len > 0 && state0.begin ()[len - 1] == 0)
+    --len;
+  assert (len > 0);
+
+  memcpy (data + 1, state0.begin (), len);
+  if (data[len] & 128)
+    data[1 + len++] = 0;
+  data[0] = len;
+
+  CHash256 ().Write (data, 1 + len).Finalize (state0.begin ());
+  LoadState ();
 }
 
 int
 RandomGenerator::GetIntRnd (int modulo)
 {
-  // Advance generator state, if most bits of the current state were used
-  if (state < MIN_STATE)
-    {
-      /* The original "legacy" implementation based on CBigNum serialised
-         the value based on valtype and with leading zeros removed.  For
-         compatibility with the old consensus behaviour, we replicate this.  */
-
-      valtype data(state0.begin (), state0.end ());
-      while (data.back () == 0)
-        data.pop_back ();
+  assert (modulo > 0);
 
-      /* The legacy representation uses the highest bit as sign bit.  Thus
-         we have to add a zero at the end if the highest bit is set.  */
-      if (data.back () & 128)
-        data.push_back (0);
+  // Advance generator state, if most bits of the current state were used
+  for (int i = LIMBS - 1; i >= 0; --i)
+    if (state[i] != MIN_STATE[i])
+      {
+        if (state[i] < MIN_STATE[i])
+          Reseed ();
+        break;
+      }
 
-      state0 = SerializeHash (data, SER_GETHASH, 0);
-      state = UintToArith256 (state0);
+  /* Divide the state in place by modulo and return the remainder.  This
+     is the schoolbook division by a single limb, starting with the most
+     significant one.  It gives the same result as arith_uint256 division
+     with less work.  */
+  const uint64_t mod = modulo;
+  uint64_t rem = 0;
+  for (int i = LIMBS - 1; i >= 0; --i)
+    {
+      const uint64_t cur = (rem << 32) | state[i];
+      state[i] = cur / mod;
+      rem = cur % mod;
     }
 
-  arith_uint256 res = state;
-  state /= modulo;
-  res -= state * modulo;
-
-  assert (res.bits () < 64);
-  return res.GetLow64 ();
+  return rem;
 }
 
-const arith_uint256 RandomGenerator::MIN_STATE
-  = arith_uint256().SetCompact (0x097FFFFFu);
+/* This is arith_uint256().SetCompact (0x097FFFFFu), i. e., 0x7FFFFF << 48.  */
+const uint32_t RandomGenerator::MIN_STATE[RandomGenerator::LIMBS]
+  = {0, 0xFFFF0000u, 0x7F, 0, 0, 0, 0, 0};
@@ -52,6 +52,8 @@ struct CharacterID
     }
 
     std::string ToString() const;
+    // Parse the "player" or "player.N" format produced by ToString
+    bool FromString(const std::string &str);
 
     bool operator==(const CharacterID &that) const { return player == that.player && index == that.index; }
     bool operator!=(const CharacterID &that) const { return !(*this == that); }
@@ -109,9 +111,22 @@ public:
     }
 
 private:
+    /* Number of 32-bit limbs in the state.  */
+    static const int LIMBS = 8;
+
+    /* The last hash, from which the state is reseeded once most of its
+       bits have been used up.  */
     uint256 state0;
-    arith_uint256 state;
-    static const arith_uint256 MIN_STATE;
+    /* The remaining state as 256-bit number in little-endian 32-bit limbs,
+       like arith_uint256.  Random numbers are the remainders of dividing
+       it by the requested modulo.  */
+    uint32_t state[LIMBS];
+    static const uint32_t MIN_STATE[LIMBS];
+
+    /* Set the state from state0.  */
+    void LoadState ();
+    /* Hash state0 again and load the new state.  */
+    void Reseed ();
 };
 
 #endif
@@ -20,11 +20,21 @@
 #include <consensus/validation.h>
 #include <game/move.h>
 #include <game/state.h>
+#include <hash.h>
+#include <init.h>
+#include <memusage.h>
+#include <ui_interface.h>
 #include <util.h>
 #include <validation.h>
 
-#include <vector>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <boost/thread.hpp>
 
@@ -32,22 +42,321 @@
    need them so we can tell game states apart from the obfuscation key that
    is also in the database.  */
 static const char DB_GAMESTATE = 'g';
-
-/* Define some configuration parameters.  */
-/* TODO: Make them CLI options.  */
+/* Key for the block hash of the last checkpoint during -reindex-gamestate.
+   It is only present while a reindex is in progress.  */
+static const char DB_REINDEX_CHECKPOINT = 'r';
+/* Marks game states imported from a snapshot, which are never pruned.  */
+static const char DB_IMPORTED = 'i';
+/* Marks game states that do not fit the keep-every-nth policy and were
+   only written to disk at shutdown.  They are removed again with the next
+   flush, which can then find them without reading all states.  */
+static const char DB_TRANSIENT = 't';
+/* Present once states written by older versions (which did not use
+   DB_TRANSIENT) have been checked and marked as needed.  */
+static const char DB_TRANSIENT_UPGRADED = 'u';
+
+/* Magic bytes and version at the start of a game state snapshot file.  */
+static const char SNAPSHOT_MAGIC[] = {'h', 'u', 'c', 'g', 's'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+/* Define some configuration parameters.  Only the memory limit of the
+   state cache is a CLI option (-gamecache), which is passed to the
+   constructor.  The values below are deliberately kept as compile-time
+   constants.  */
 static const unsigned KEEP_EVERY_NTH = 2000;
 static const unsigned MIN_IN_MEMORY = 10;
-static const unsigned MAX_IN_MEMORY = 100;
+static const unsigned MAX_SIDE_BRANCH = 10;
 static const unsigned DB_CACHE_SIZE = (25 << 20);
+/* Number of blocks the reindex prefetch thread may read ahead.  */
+static const size_t REINDEX_PREFETCH_BLOCKS = 32;
+/* Number of flushes that may wait for the background writer before
+   flushing blocks.  */
+static const size_t MAX_PENDING_FLUSHES = 2;
+
+/* Memory used by a game state held in the cache.  */
+static size_t
+StateUsage (const std::shared_ptr<const GameState>& state)
+{
+  return memusage::DynamicUsage (state) + state->DynamicMemoryUsage ();
+}
+
+/**
+ * Background thread that writes the states evicted by flushes to the
+ * database.  The states are shared with the cache, which never modifies
+ * them.  Until they are written, they can be looked up here.
+ */
+class CGameDB::Writer
+{
+
+public:
+
+  /** A state to write, and whether it is kept by the keep-every-nth policy
+      (rather than only written because of a shutdown).  */
+  struct Entry
+  {
+    std::shared_ptr<const GameState> state;
+    bool permanent;
+  };
+
+private:
+
+  CDBWrapper& db;
+
+  mutable std::mutex mut;
+  std::condition_variable cv;
+  /** Flushes not yet written, in order.  */
+  std::deque<std::vector<Entry>> queue;
+  /** States of all flushes in the queue, for lookups.  */
+  std::unordered_map<uint256, std::shared_ptr<const GameState>,
+                     HashHasher> pending;
+  /** Set while a flush is written (and no longer in queue).  */
+  bool busy;
+  bool stopped;
+
+  std::thread thread;
+
+  void write (const std::vector<Entry>& entries);
+  void run ();
+
+public:
+
+  explicit Writer (CDBWrapper& d);
+
+  /* Writes all queued flushes before stopping the thread.  */
+  ~Writer ();
+
+  /**
+   * Queue the states of a flush for writing.  This blocks while
+   * MAX_PENDING_FLUSHES are already waiting.
+   */
+  void push (std::vector<Entry>&& entries);
+
+  /**
+   * Look up a state waiting to be written.  Returns null if there
+   * is none.
+   */
+  std::shared_ptr<const GameState> lookup (const uint256& hash) const;
+
+  /**
+   * Wait until everything queued has been written.
+   */
+  void waitIdle ();
+
+};
+
+CGameDB::Writer::Writer (CDBWrapper& d)
+  : db(d), busy(false), stopped(false)
+{
+  thread = std::thread (&TraceThread<std::function<void ()>>, "gamedb",
+                        std::bind (&Writer::run, this));
+}
+
+CGameDB::Writer::~Writer ()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut);
+    stopped = true;
+  }
+  cv.notify_all ();
+  thread.join ();
+  assert (queue.empty ());
+}
+
+void
+CGameDB::Writer::push (std::vector<Entry>&& entries)
+{
+  std::unique_lock<std::mutex> lock(mut);
+  cv.wait (lock, [this] () { return queue.size () < MAX_PENDING_FLUSHES; });
+
+  for (const auto& e : entries)
+    pending[e.state->hashBlock] = e.state;
+  queue.push_back (std::move (entries));
+  cv.notify_all ();
+}
+
+std::shared_ptr<const GameState>
+CGameDB::Writer::lookup (const uint256& hash) const
+{
+  std::lock_guard<std::mutex> lock(mut);
+  const auto mi = pending.find (hash);
+  if (mi == pending.end ())
+    return nullptr;
+
+  return mi->second;
+}
+
+void
+CGameDB::Writer::waitIdle ()
+{
+  std::unique_lock<std::mutex> lock(mut);
+  cv.wait (lock, [this] () { return queue.empty () && !busy; });
+}
+
+void
+CGameDB::Writer::run ()
+{
+  while (true)
+    {
+      std::vector<Entry> entries;
+      {
+        std::unique_lock<std::mutex> lock(mut);
+        cv.wait (lock, [this] () { return stopped || !queue.empty (); });
+        if (queue.empty ())
+          return;
+
+        entries = std::move (queue.front ());
+        queue.pop_front ();
+        busy = true;
+        cv.notify_all ();
+      }
+
+      write (entries);
+
+      std::lock_guard<std::mutex> lock(mut);
+      for (const auto& e : entries)
+        {
+          /* The same state may have been queued again by a later flush.  */
+          const auto mi = pending.find (e.state->hashBlock);
+          if (mi != pending.end () && mi->second == e.state)
+            pending.erase (mi);
+        }
+      busy = false;
+      cv.notify_all ();
+    }
+}
+
+void
+CGameDB::Writer::write (const std::vector<Entry>& entries)
+{
+  CDBBatch batch(db);
+
+  /* Purge states from disk that were only written there due to the last
+     shutdown.  This is done first, so that states written again below
+     (in the same batch) stay.  */
+  unsigned purged = 0;
+  std::unique_ptr<CDBIterator> pcursor(db.NewIterator ());
+  for (pcursor->Seek (DB_TRANSIENT); pcursor->Valid (); pcursor->Next ())
+    {
+      std::pair<char, uint256> key;
+      if (!pcursor->GetKey (key) || key.first != DB_TRANSIENT)
+        break;
+
+      batch.Erase (key);
+      batch.Erase (std::make_pair (DB_GAMESTATE, key.second));
+      ++purged;
+    }
+
+  /* States not fitting the policy are marked so that they are removed
+     again with the next flush.  */
+  for (const auto& e : entries)
+    {
+      const uint256& hash = e.state->hashBlock;
+      batch.Write (std::make_pair (DB_GAMESTATE, hash), *e.state);
+      if (!e.permanent && !db.Exists (std::make_pair (DB_IMPORTED, hash)))
+        batch.Write (std::make_pair (DB_TRANSIENT, hash), true);
+    }
+
+  if (!db.WriteBatch (batch))
+    error ("%s: failed to write game db", __func__);
+  LogPrint (BCLog::GAME, "Wrote %u game states, pruned %u from disk\n",
+            entries.size (), purged);
+}
+
+uint256
+GetGameStateHash (const GameState& state)
+{
+  return SerializeHash (state);
+}
+
+bool
+WriteGameStateSnapshot (const fs::path& path, const GameState& state,
+                        uint256& hash)
+{
+  hash = GetGameStateHash (state);
+
+  /* Write to a temporary file first, so that no incomplete snapshot
+     is left behind at the final path.  */
+  const fs::path pathTmp = path.string () + ".incomplete";
+  CAutoFile file(fsbridge::fopen (pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+  if (file.IsNull ())
+    return error ("%s: failed to open %s", __func__, pathTmp.string ());
+
+  try
+    {
+      file.write (SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC));
+      file << SNAPSHOT_VERSION << state << hash;
+    }
+  catch (const std::exception& e)
+    {
+      return error ("%s: I/O error - %s", __func__, e.what ());
+    }
+
+  FileCommit (file.Get ());
+  file.fclose ();
+  if (!RenameOver (pathTmp, path))
+    return error ("%s: failed to rename %s", __func__, pathTmp.string ());
+
+  return true;
+}
+
+bool
+ReadGameStateSnapshot (const fs::path& path, GameState& state,
+                       uint256& hash, std::string& err)
+{
+  CAutoFile file(fsbridge::fopen (path, "rb"), SER_DISK, CLIENT_VERSION);
+  if (file.IsNull ())
+    {
+      err = "failed to open snapshot file";
+      return false;
+    }
+
+  try
+    {
+      char magic[sizeof (SNAPSHOT_MAGIC)];
+      file.read (magic, sizeof (magic));
+      if (!std::equal (magic, magic + sizeof (magic), SNAPSHOT_MAGIC))
+        {
+          err = "not a game state snapshot";
+          return false;
+        }
+
+      uint32_t version;
+      file >> version;
+      if (version != SNAPSHOT_VERSION)
+        {
+          err = strprintf ("unsupported snapshot version %d", version);
+          return false;
+        }
+
+      file >> state >> hash;
+    }
+  catch (const std::exception& e)
+    {
+      err = strprintf ("failed to read snapshot: %s", e.what ());
+      return false;
+    }
 
-CGameDB::CGameDB (bool fMemory, bool fWipe)
+  if (GetGameStateHash (state) != hash)
+    {
+      err = "snapshot does not match its hash commitment";
+      return false;
+    }
+
+  return true;
+}
+
+CGameDB::CGameDB (bool fMemory, bool fWipe, size_t cacheSize)
   : keepEveryNth(KEEP_EVERY_NTH),
-    minInMemory(MIN_IN_MEMORY), maxInMemory(MAX_IN_MEMORY),
+    minInMemory(MIN_IN_MEMORY), maxSideBranch(MAX_SIDE_BRANCH),
+    maxCacheSize(cacheSize),
     keepEverything(false),
     db(GetDataDir() / "gamestates", DB_CACHE_SIZE, fMemory, fWipe, true),
-    cache(), cs_cache()
+    writer(new Writer (db)),
+    cache(), stateUsage(0),
+    mainChain(MIN_IN_MEMORY, std::make_pair (-1, uint256 ())),
+    tipHeight(-1), cs_cache()
 {
-  // Nothing else to do.
+  markLegacyTransient ();
 }
 
 CGameDB::~CGameDB ()
@@ -55,6 +364,50 @@ CGameDB::~CGameDB ()
   LOCK (cs_cache);
   flush (true);
   assert (cache.empty ());
+
+  /* Wait for everything to be written.  */
+  writer.reset ();
+}
+
+void
+CGameDB::markLegacyTransient ()
+{
+  if (db.Exists (DB_TRANSIENT_UPGRADED))
+    return;
+
+  /* Older versions wrote all states in memory at shutdown and pruned those
+     not fitting the keep-every-nth policy with the next flush.  Mark them
+     as transient, so that they are still available for warming up, but
+     are removed again with the next flush.  */
+  CDBBatch batch(db);
+  unsigned marked = 0;
+  std::unique_ptr<CDBIterator> pcursor(db.NewIterator ());
+  for (pcursor->Seek (DB_GAMESTATE); pcursor->Valid (); pcursor->Next ())
+    {
+      std::pair<char, uint256> key;
+      if (!pcursor->GetKey (key) || key.first != DB_GAMESTATE)
+        break;
+
+      GameState state(Params ().GetConsensus ());
+      if (!pcursor->GetValue (state))
+        {
+          error ("%s: failed to read game state", __func__);
+          continue;
+        }
+      if (state.nHeight % keepEveryNth == 0
+            || db.Exists (std::make_pair (DB_IMPORTED, key.second)))
+        continue;
+
+      batch.Write (std::make_pair (DB_TRANSIENT, key.second), true);
+      ++marked;
+    }
+  batch.Write (DB_TRANSIENT_UPGRADED, true);
+
+  if (!db.WriteBatch (batch, true))
+    error ("%s: failed to write game db", __func__);
+  if (marked > 0)
+    LogPrintf ("Marked %u game states from an older version as transient\n",
+               marked);
 }
 
 bool
@@ -71,6 +424,16 @@ CGameDB::getFromCache (const uint256& hash, GameState& state) const
       }
   }
 
+  /* States evicted from the cache are either waiting for the writer or
+     already written, so there is no gap between the lookups.  */
+  const auto pending = writer->lookup (hash);
+  if (pending)
+    {
+      state = *pending;
+      assert (hash == state.hashBlock);
+      return true;
+    }
+
   if (!db.Read (std::make_pair (DB_GAMESTATE, hash), state))
     return false;
 
@@ -139,137 +502,499 @@ CGameDB::get (const uint256& hash, GameState& state)
   return true;
 }
 
+std::shared_ptr<const GameState>
+CGameDB::getShared (const uint256& hash)
+{
+  {
+    LOCK (cs_cache);
+    const GameStateMap::const_iterator mi = cache.find (hash);
+    if (mi != cache.end ())
+      return mi->second;
+  }
+
+  auto res = writer->lookup (hash);
+  if (res)
+    return res;
+
+  /* get() stores a recomputed state in the cache, but we return our own
+     copy in any case.  It is not worth to look it up again.  */
+  auto state = std::make_shared<GameState> (Params ().GetConsensus ());
+  if (!get (hash, *state))
+    return nullptr;
+
+  return state;
+}
+
 void
 CGameDB::store (const uint256& hash, const GameState& state)
 {
   assert (hash == state.hashBlock);
   LOCK (cs_cache);
 
-  const GameStateMap::iterator mi = cache.find (hash);
-  if (mi != cache.end ())
+  std::shared_ptr<const GameState>& entry = cache[hash];
+  if (entry)
+    stateUsage -= StateUsage (entry);
+  entry = std::make_shared<const GameState> (state);
+  stateUsage += StateUsage (entry);
+
+  attemptFlush ();
+}
+
+void
+CGameDB::setTip (const CBlockIndex* pindex)
+{
+  LOCK (cs_cache);
+
+  if (pindex == nullptr)
     {
-      delete mi->second;
-      mi->second = new GameState (Params ().GetConsensus ());
-      *mi->second = state;
+      tipHeight = -1;
+      return;
     }
-  else
+  tipHeight = pindex->nHeight;
+
+  /* Fill in the ring going back from the new tip.  As soon as an entry
+     matches already, all before it do as well.  Thus connecting a block
+     only updates a single entry.  */
+  const int n = mainChain.size ();
+  for (int i = 0; pindex && i < n; ++i, pindex = pindex->pprev)
     {
-      std::unique_ptr<GameState> s(new GameState (Params ().GetConsensus ()));
-      *s = state;
-      cache.insert (std::make_pair (hash, s.release ()));
+      auto& entry = mainChain[pindex->nHeight % n];
+      if (entry.first == pindex->nHeight && entry.second == *pindex->phashBlock)
+        break;
+      entry = std::make_pair (pindex->nHeight, *pindex->phashBlock);
     }
+}
 
-  attemptFlush ();
+bool
+CGameDB::isRecentMainChain (const uint256& hash, int height) const
+{
+  AssertLockHeld (cs_cache);
+
+  const int n = mainChain.size ();
+  if (height < 0 || height > tipHeight || height <= tipHeight - n)
+    return false;
+
+  const auto& entry = mainChain[height % n];
+  return entry.first == height && entry.second == hash;
 }
 
-void
-CGameDB::flush (bool saveAll)
+size_t
+CGameDB::cacheUsage () const
 {
   AssertLockHeld (cs_cache);
-  LogPrint (BCLog::GAME, "Flushing game db to disk...\n");
+  return memusage::DynamicUsage (cache) + memusage::DynamicUsage (mainChain)
+          + stateUsage;
+}
+
+size_t
+CGameDB::dynamicMemoryUsage () const
+{
+  LOCK (cs_cache);
+  return cacheUsage ();
+}
+
+size_t
+CGameDB::cachedStates () const
+{
+  LOCK (cs_cache);
+  return cache.size ();
+}
+
+bool
+CGameDB::importState (const GameState& state)
+{
+  GameState existing(Params ().GetConsensus ());
+  if (getFromCache (state.hashBlock, existing))
+    {
+      if (GetGameStateHash (existing) != GetGameStateHash (state))
+        return error ("%s: snapshot does not match the known state of"
+                      " block %s", __func__, state.hashBlock.GetHex ());
+    }
 
-  /* Find blocks that we want to continue to hold in memory.  These are
-     main-chain blocks with recent height.  */
-  std::set<uint256> keepInMemory;
+  /* If the state was written transiently at the last shutdown, remove
+     the marker so that the next flush does not purge it.  */
+  CDBBatch batch(db);
+  batch.Write (std::make_pair (DB_GAMESTATE, state.hashBlock), state);
+  batch.Write (std::make_pair (DB_IMPORTED, state.hashBlock), true);
+  batch.Erase (std::make_pair (DB_TRANSIENT, state.hashBlock));
+  if (!db.WriteBatch (batch, true))
+    return error ("%s: failed to write game db", __func__);
+
+  LogPrintf ("Imported game state at height %d (block %s)\n",
+             state.nHeight, state.hashBlock.GetHex ());
+  return true;
+}
+
+void
+CGameDB::warmUp ()
+{
+  const CChainParams& chainparams = Params ();
+
+  /* Find the blocks that have to be replayed, starting from the latest
+     state that is already available.  Only the states of the last
+     minInMemory blocks are kept, like flush() would do.  */
+  GameState stateIn(chainparams.GetConsensus ());
+  std::vector<const CBlockIndex*> needed;
+  int minHeight;
   {
     LOCK (cs_main);
-
     const CBlockIndex* pindex = chainActive.Tip ();
-    assert (pindex);
-    const int minHeight = pindex->nHeight - minInMemory;
-    for (; pindex && pindex->nHeight > minHeight; pindex = pindex->pprev)
-      keepInMemory.insert (*pindex->phashBlock);
+    if (pindex == nullptr)
+      return;
+    minHeight = pindex->nHeight - minInMemory;
+    setTip (pindex);
+
+    for (; pindex; pindex = pindex->pprev)
+      {
+        if (getFromCache (*pindex->phashBlock, stateIn))
+          break;
+        needed.push_back (pindex);
+      }
   }
 
-  /* Go through everything and delete or store to disk.  */
-  std::set<uint256> toErase;
-  CDBBatch batch(db);
-  unsigned written = 0, discarded = 0;
-  for (GameStateMap::iterator mi = cache.begin (); mi != cache.end (); ++mi)
+  if (needed.empty ())
+    return;
+
+  LogPrintf ("Rebuilding game states from height %d to height %d\n",
+             stateIn.nHeight, needed.front ()->nHeight);
+  const std::string title = _("Rebuilding game states...");
+  const size_t total = needed.size ();
+  int lastProgress = -1;
+
+  while (!needed.empty ())
     {
-      bool keepThis = (keepInMemory.count (mi->first) > 0);
-      if (!saveAll && keepThis)
-        continue;
+      boost::this_thread::interruption_point ();
 
-      LOCK (cs_main);
-      bool write = keepThis;
-
-      /* It can happen that cache contains blocks that are not in mapBlockIndex.
-         This is the case if they were added to the cache through ConnectBlock
-         called from TestBlockValidity and mining (or testing).  If this is
-         not the case and the block is part of mapBlockIndex, we can look
-         at the block's height and keep it if the height is divisible
-         by KEEP_EVERY_NTH.  */
-      const BlockMap::const_iterator bmi = mapBlockIndex.find (mi->first);
-      if (!write && bmi != mapBlockIndex.end ())
+      const CBlockIndex* pindex = needed.back ();
+      needed.pop_back ();
+      assert (stateIn.nHeight + 1 == pindex->nHeight);
+
+      CBlock block;
+      if (!ReadBlockFromDisk (block, pindex, chainparams.GetConsensus ()))
         {
-          const CBlockIndex* pindex = bmi->second;
-          assert (pindex);
-          write = (pindex->nHeight % keepEveryNth == 0);
+          error ("%s: failed to read block from disk", __func__);
+          break;
         }
 
-      if (write)
+      GameState state(chainparams.GetConsensus ());
+      CValidationState valid;
+      StepResult res;
+      if (!PerformStep (block, stateIn, nullptr, valid, res, state))
         {
-          batch.Write (std::make_pair (DB_GAMESTATE, mi->first), *mi->second);
-          ++written;
+          error ("%s: failed to perform game step", __func__);
+          break;
         }
-      else
-        ++discarded;
+      assert (state.hashBlock == *pindex->phashBlock);
+
+      if (pindex->nHeight > minHeight)
+        store (state.hashBlock, state);
+      stateIn = std::move (state);
 
-      delete mi->second;
-      toErase.insert (mi->first);
+      const int progress = (total - needed.size ()) * 100 / total;
+      if (progress != lastProgress)
+        {
+          uiInterface.ShowProgress (title, progress, false);
+          lastProgress = progress;
+        }
     }
-  for (std::set<uint256>::const_iterator i = toErase.begin ();
-       i != toErase.end (); ++i)
-    cache.erase (*i);
-  assert (!saveAll || cache.empty ());
-  LogPrint (BCLog::GAME, "  wrote %u game states, discarded %u\n",
-            written, discarded);
-
-  /* Purge unwanted elements from the database on disk.  They may have been
-     stored due to the last shutdown and now be unwanted due to advancing
-     the chain since then.  */
-  /* TODO: Possibly not do this always.  We could do it for saveAll only,
-     or with an explicit call.  Depends on how long this usually takes.  */
-  discarded = 0;
+
+  uiInterface.ShowProgress ("", 100, false);
+  LogPrintf ("Game states rebuilt up to height %d\n", stateIn.nHeight);
+}
+
+void
+CGameDB::startReindex ()
+{
+  if (isReindexing ())
+    {
+      LogPrintf ("Resuming previous game state reindex\n");
+      return;
+    }
+
+  LOCK (cs_cache);
+  cache.clear ();
+  stateUsage = 0;
+  writer->waitIdle ();
+
+  CDBBatch batch(db);
   std::unique_ptr<CDBIterator> pcursor(db.NewIterator ());
-  for (pcursor->Seek (DB_GAMESTATE); pcursor->Valid (); pcursor->Next ())
+  for (const char type : {DB_GAMESTATE, DB_IMPORTED, DB_TRANSIENT})
+    for (pcursor->Seek (type); pcursor->Valid (); pcursor->Next ())
+      {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey (key) || key.first != type)
+          break;
+        batch.Erase (key);
+      }
+  batch.Write (DB_REINDEX_CHECKPOINT, uint256 ());
+
+  if (!db.WriteBatch (batch, true))
+    error ("%s: failed to write game db", __func__);
+}
+
+bool
+CGameDB::isReindexing () const
+{
+  return db.Exists (DB_REINDEX_CHECKPOINT);
+}
+
+namespace
+{
+
+/**
+ * Reads blocks from disk in a separate thread, so that the game steps
+ * can be performed at the same time.
+ */
+class BlockPrefetcher
+{
+
+private:
+
+  /** Disk positions and hashes of the blocks to read, in order.  */
+  std::vector<std::pair<CDiskBlockPos, uint256>> blocks;
+
+  std::mutex mut;
+  std::condition_variable cv;
+  /** Blocks read but not yet consumed.  A null entry signals an error.  */
+  std::deque<std::shared_ptr<const CBlock>> queue;
+  bool stopped;
+
+  std::thread thread;
+
+  void
+  run ()
+  {
+    /* The block positions are looked up beforehand, so that no cs_main
+       lock is needed here.  The caller may be holding it.  */
+    const Consensus::Params& params = Params ().GetConsensus ();
+    for (const auto& entry : blocks)
+      {
+        auto pblock = std::make_shared<CBlock> ();
+        if (!ReadBlockFromDisk (*pblock, entry.first, params)
+              || pblock->GetHash () != entry.second)
+          {
+            error ("%s: failed to read block %s from disk",
+                   __func__, entry.second.GetHex ());
+            pblock.reset ();
+          }
+
+        std::unique_lock<std::mutex> lock(mut);
+        cv.wait (lock, [this] ()
+          {
+            return stopped || queue.size () < REINDEX_PREFETCH_BLOCKS;
+          });
+        if (stopped)
+          return;
+        queue.push_back (pblock);
+        cv.notify_all ();
+
+        if (!pblock)
+          return;
+      }
+  }
+
+public:
+
+  explicit BlockPrefetcher (const std::vector<const CBlockIndex*>& indices)
+    : stopped(false)
+  {
     {
-      boost::this_thread::interruption_point();
-      char chType;
-      if (!pcursor->GetKey(chType) || chType != DB_GAMESTATE)
-        break;
+      LOCK (cs_main);
+      for (const CBlockIndex* pindex : indices)
+        blocks.emplace_back (pindex->GetBlockPos (), pindex->GetBlockHash ());
+    }
 
-      std::pair<char, uint256> key;
-      if (!pcursor->GetKey (key) || key.first != DB_GAMESTATE)
+    thread = std::thread (&BlockPrefetcher::run, this);
+  }
+
+  ~BlockPrefetcher ()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mut);
+      stopped = true;
+    }
+    cv.notify_all ();
+    thread.join ();
+  }
+
+  /**
+   * Return the next block in order, or null if it could not be read.
+   */
+  std::shared_ptr<const CBlock>
+  next ()
+  {
+    std::unique_lock<std::mutex> lock(mut);
+    cv.wait (lock, [this] () { return !queue.empty (); });
+    auto res = queue.front ();
+    queue.pop_front ();
+    cv.notify_all ();
+    return res;
+  }
+
+};
+
+} // anonymous namespace
+
+bool
+CGameDB::reindex ()
+{
+  uint256 hashCheckpoint;
+  if (!db.Read (DB_REINDEX_CHECKPOINT, hashCheckpoint))
+    return true;
+
+  const CChainParams& chainparams = Params ();
+  GameState stateIn(chainparams.GetConsensus ());
+  std::vector<const CBlockIndex*> blocks;
+  int minHeight;
+  {
+    LOCK (cs_main);
+    if (chainActive.Tip () == nullptr)
+      return true;
+    minHeight = chainActive.Height () - minInMemory;
+    setTip (chainActive.Tip ());
+
+    /* Resume from the checkpoint if it is still in the main chain.  */
+    int startHeight = 0;
+    if (!hashCheckpoint.IsNull ())
+      {
+        const CBlockIndex* pindex = LookupBlockIndex (hashCheckpoint);
+        if (pindex && chainActive.Contains (pindex)
+              && db.Read (std::make_pair (DB_GAMESTATE, hashCheckpoint),
+                          stateIn))
+          startHeight = pindex->nHeight + 1;
+        else
+          {
+            LogPrintf ("Game state reindex checkpoint not usable,"
+                       " starting from genesis\n");
+            stateIn = GameState (chainparams.GetConsensus ());
+          }
+      }
+
+    for (int h = startHeight; h <= chainActive.Height (); ++h)
+      blocks.push_back (chainActive[h]);
+  }
+
+  if (blocks.empty ())
+    {
+      db.Erase (DB_REINDEX_CHECKPOINT, true);
+      return true;
+    }
+
+  LogPrintf ("Reindexing game states from height %d to height %d\n",
+             blocks.front ()->nHeight, blocks.back ()->nHeight);
+  const std::string title = _("Reindexing game states...");
+  const size_t total = blocks.size ();
+  int lastProgress = -1;
+
+  BlockPrefetcher prefetcher(blocks);
+  for (size_t i = 0; i < total; ++i)
+    {
+      if (ShutdownRequested ())
         {
-          error ("%s: failed to read game state key", __func__);
-          break;
+          LogPrintf ("Game state reindex interrupted at height %d\n",
+                     stateIn.nHeight);
+          return false;
         }
 
-      /* Check first if this is in our keep-in-memory list.  If it is
-         and we want to "save all", keep it.  */
-      const bool keepThis = (keepInMemory.count (key.second) > 0);
-      if (saveAll && keepThis)
-        continue;
+      const CBlockIndex* pindex = blocks[i];
+      const auto pblock = prefetcher.next ();
+      if (!pblock)
+        return error ("%s: failed to read block at height %d",
+                      __func__, pindex->nHeight);
+      assert (stateIn.nHeight + 1 == pindex->nHeight);
+
+      GameState state(chainparams.GetConsensus ());
+      CValidationState valid;
+      StepResult res;
+      if (!PerformStep (*pblock, stateIn, nullptr, valid, res, state))
+        return error ("%s: failed to perform game step", __func__);
+      assert (state.hashBlock == *pindex->phashBlock);
+
+      /* Checkpoint at the heights that are kept on disk anyway.  */
+      if (pindex->nHeight % keepEveryNth == 0)
+        {
+          CDBBatch batch(db);
+          batch.Write (std::make_pair (DB_GAMESTATE, state.hashBlock), state);
+          batch.Write (DB_REINDEX_CHECKPOINT, state.hashBlock);
+          if (!db.WriteBatch (batch, true))
+            return error ("%s: failed to write checkpoint", __func__);
+        }
 
-      /* Otherwise, check for block height condition and delete if
-         this is not a state we want to keep.  */
-      LOCK (cs_main);
-      const BlockMap::const_iterator bmi = mapBlockIndex.find (key.second);
-      assert (bmi != mapBlockIndex.end ());
-      const CBlockIndex* pindex = bmi->second;
-      assert (pindex);
-      if (pindex->nHeight % keepEveryNth != 0)
+      if (pindex->nHeight > minHeight)
+        store (state.hashBlock, state);
+      stateIn = std::move (state);
+
+      const int progress = (i + 1) * 100 / total;
+      if (progress != lastProgress)
         {
-          ++discarded;
-          batch.Erase (key);
+          uiInterface.ShowProgress (title, progress, false);
+          lastProgress = progress;
         }
     }
-  LogPrint (BCLog::GAME, "  pruning %u game states from disk\n", discarded);
 
-  /* Finalise by writing the database batch.  */
-  const bool ok = db.WriteBatch (batch);
-  if (!ok)
-    error ("failed to write game db");
+  uiInterface.ShowProgress ("", 100, false);
+  db.Erase (DB_REINDEX_CHECKPOINT, true);
+  LogPrintf ("Game state reindex finished at height %d\n", stateIn.nHeight);
+
+  return true;
+}
+
+void
+CGameDB::flush (bool saveAll)
+{
+  AssertLockHeld (cs_cache);
+  LogPrint (BCLog::GAME, "Flushing game db to disk...\n");
+
+  /* Decide which states to hold in memory.  These are the recent main-chain
+     states, and the other ones (side branches or older main-chain blocks)
+     with the highest heights, as long as they fit into half of the memory
+     limit.  This leaves room before the next flush.  */
+  std::vector<GameStateMap::iterator> others;
+  size_t keptUsage = memusage::DynamicUsage (mainChain);
+  for (auto mi = cache.begin (); mi != cache.end (); ++mi)
+    {
+      if (!saveAll && isRecentMainChain (mi->first, mi->second->nHeight))
+        keptUsage += StateUsage (mi->second);
+      else
+        others.push_back (mi);
+    }
+  if (!saveAll)
+    {
+      std::sort (others.begin (), others.end (),
+                 [] (const GameStateMap::iterator& a,
+                     const GameStateMap::iterator& b)
+                   {
+                     return a->second->nHeight > b->second->nHeight;
+                   });
+
+      unsigned kept = 0;
+      for (; kept < others.size () && kept < maxSideBranch; ++kept)
+        {
+          keptUsage += StateUsage (others[kept]->second);
+          if (keptUsage > maxCacheSize / 2)
+            break;
+        }
+      others.erase (others.begin (), others.begin () + kept);
+    }
+
+  /* Hand the evicted states to the writer or discard them.  When saving
+     all, states not fitting the policy are written as well.  */
+  std::vector<Writer::Entry> toWrite;
+  unsigned discarded = 0;
+  for (const auto& mi : others)
+    {
+      const bool keep = (mi->second->nHeight % keepEveryNth == 0);
+      if (keep || saveAll)
+        toWrite.push_back ({mi->second, keep});
+      else
+        ++discarded;
+
+      stateUsage -= StateUsage (mi->second);
+      cache.erase (mi);
+    }
+  assert (!saveAll || cache.empty ());
+  LogPrint (BCLog::GAME, "  writing %u game states, discarded %u\n",
+            toWrite.size (), discarded);
+
+  writer->push (std::move (toWrite));
 }
@@ -17,13 +17,52 @@
 #define BITCOIN_GAME_DB
 
 #include <dbwrapper.h>
+#include <fs.h>
 #include <sync.h>
 #include <uint256.h>
 
-#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+class CBlockIndex;
 class GameState;
 
+/** Default for -gamecache, the size of the in-memory game state cache in MiB.  */
+static const int64_t DEFAULT_GAME_CACHE = 100;
+/** Minimum for -gamecache in MiB.  */
+static const int64_t MIN_GAME_CACHE = 4;
+
+/**
+ * Compute the hash commitment of a game state, which is the hash of its
+ * serialisation.  It is used to verify game state snapshots.
+ */
+uint256 GetGameStateHash (const GameState& state);
+
+/**
+ * Write a snapshot of the game state to a file.  The file contains the
+ * serialised state followed by its hash commitment.
+ * @param path The file to write.
+ * @param state The game state.
+ * @param hash Set to the state's hash commitment.
+ * @return True iff successful.
+ */
+bool WriteGameStateSnapshot (const fs::path& path, const GameState& state,
+                             uint256& hash);
+
+/**
+ * Read a game state snapshot written by WriteGameStateSnapshot and verify
+ * it against the hash commitment stored with it.
+ * @param path The file to read.
+ * @param state Put the game state here.
+ * @param hash Set to the state's hash commitment.
+ * @param err Set to an error message on failure.
+ * @return True iff successful.
+ */
+bool ReadGameStateSnapshot (const fs::path& path, GameState& state,
+                            uint256& hash, std::string& err);
+
 /**
  * Database for caching game states.  Note that each block hash corresponds
  * uniquely to a game state.  Game states can never change, they are only
@@ -33,15 +72,27 @@ class GameState;
  * Thus it is in its own class and directory, not using the chainstate.
  *
  * The database (on disk) stores the states to every Nth block.  Intermediate
- * steps can be recomputed, but that is costly.  The last few states are kept
- * in memory, so that reorgs can be done efficiently.
+ * steps can be recomputed, but that is costly.  The states of the last few
+ * main-chain blocks are kept in memory, and so are a few states of side
+ * branches (typically blocks that have just been disconnected), so that
+ * reorgs can be done efficiently.
+ *
+ * States evicted from memory are written to disk by a background thread,
+ * so that connecting blocks does not wait for the database.
  */
 class CGameDB
 {
 
 public:
 
-    explicit CGameDB (bool fMemory, bool fWipe);
+    /**
+     * Open the game db.
+     * @param fMemory Use an in-memory database (for testing).
+     * @param fWipe Remove all stored game states.
+     * @param cacheSize Memory limit of the in-memory cache in bytes.
+     */
+    explicit CGameDB (bool fMemory, bool fWipe,
+                      size_t cacheSize = DEFAULT_GAME_CACHE << 20);
     ~CGameDB ();
 
     /**
@@ -77,6 +128,16 @@ public:
      */
     bool get (const uint256& hash, GameState& state);
 
+    /**
+     * Query for a game state like get(), but return a shared handle to
+     * it instead of copying it.  If the state is in memory, the cached
+     * instance is returned.  States are never modified once they are
+     * stored, so the handle can be kept and used without locking.
+     * @param hash The block hash to look up.
+     * @return The game state, or null on failure.
+     */
+    std::shared_ptr<const GameState> getShared (const uint256& hash);
+
     /**
      * Store a game state.  This is in principle not necessary, since get()
      * itself also stores the game state after computing it.  We use it,
@@ -85,6 +146,75 @@ public:
      */
     void store (const uint256& hash, const GameState& state);
 
+    /**
+     * Update the main-chain position used to decide which states are kept
+     * in memory.  This must be called whenever the chain tip changes.
+     * @param pindex The new tip.
+     */
+    void setTip (const CBlockIndex* pindex);
+
+    /**
+     * Return the memory used by the in-memory states.
+     */
+    size_t dynamicMemoryUsage () const;
+
+    /**
+     * Return the number of states held in memory.
+     */
+    size_t cachedStates () const;
+
+    /**
+     * Return the memory limit of the in-memory cache.
+     */
+    size_t
+    cacheLimit () const
+    {
+      return maxCacheSize;
+    }
+
+    /**
+     * Import a game state from a snapshot.  It is written to disk and kept
+     * there regardless of the keep-every-nth policy, so that states of
+     * later blocks are computed from it rather than the genesis block.
+     * The block must be present in mapBlockIndex.  If the state for the
+     * block is already known, the import fails unless they match.
+     * @param state The game state to import.
+     * @return True iff successful.
+     */
+    bool importState (const GameState& state);
+
+    /**
+     * Rebuild the in-memory states for the last blocks of the main chain,
+     * which are otherwise recomputed on first use after a restart.  Unlike
+     * get(), this does not hold cs_main while blocks are replayed, so that
+     * the node stays responsive.  It is meant to be run in a background
+     * thread at startup and reports its progress through uiInterface.
+     */
+    void warmUp ();
+
+    /**
+     * Start rebuilding the game states from the block data (for
+     * -reindex-gamestate).  This removes all stored states and marks
+     * the database as being reindexed, unless an earlier reindex is still
+     * in progress.  In that case, it is resumed.
+     */
+    void startReindex ();
+
+    /**
+     * Check whether a reindex has been started and not yet finished.
+     */
+    bool isReindexing () const;
+
+    /**
+     * Rebuild the game states of the main chain from the block data.
+     * Blocks are read by a prefetch thread while the game steps are
+     * performed.  The state at every keepEveryNth height is written
+     * as a checkpoint, from which the reindex is resumed if it is
+     * interrupted by a shutdown request.
+     * @return True iff the reindex has been completed.
+     */
+    bool reindex ();
+
 private:
 
     /** Keep every Nth game state permanently on disk.  */
@@ -92,10 +222,16 @@ private:
     /** Minimum number of states to keep in memory (the last ones).  */
     unsigned minInMemory;
     /**
-     * Maximum number of states to keep in memory.  If this is reached,
+     * Number of states not in the last minInMemory main-chain blocks to
+     * keep in memory.  The ones with the highest heights are kept, as long
+     * as the cache stays below half of maxCacheSize.
+     */
+    unsigned maxSideBranch;
+    /**
+     * Maximum memory used by the in-memory states.  If this is reached,
      * the cache will be flushed back to disk.
      */
-    unsigned maxInMemory;
+    size_t maxCacheSize;
 
     /** Temporarily disable flushing at all and keep everything.  */
     bool keepEverything;
@@ -103,33 +239,85 @@ private:
     /** The backing LevelDB.  */
     CDBWrapper db;
 
-    typedef std::map<uint256, GameState*> GameStateMap;
-    /** In-memory store of the last few block states.  */
+    class Writer;
+    /** Background writer for evicted states.  */
+    std::unique_ptr<Writer> writer;
+
+    struct HashHasher
+    {
+      size_t
+      operator() (const uint256& hash) const
+      {
+        return hash.GetCheapHash ();
+      }
+    };
+
+    /* States are shared with the background writer and never modified
+       once they are in the cache.  */
+    typedef std::unordered_map<uint256, std::shared_ptr<const GameState>,
+                               HashHasher> GameStateMap;
+    /** In-memory store of recent block states.  */
     GameStateMap cache;
+    /** Memory used by the states in cache (not the map itself).  */
+    size_t stateUsage;
+
+    /**
+     * Ring of the last minInMemory main-chain blocks, indexed by height
+     * modulo its size.  Entries are valid if their height is within
+     * minInMemory of tipHeight.  This allows to decide which states to keep
+     * without looking at chainActive.
+     */
+    std::vector<std::pair<int, uint256>> mainChain;
+    /** Height of the current chain tip, or -1 if not yet known.  */
+    int tipHeight;
+
     /** Lock to protect the cache datastructure.  */
     mutable CCriticalSection cs_cache;
 
     /**
      * Get without recomputation.  Returns false if the state is not
-     * readily available.
+     * readily available.  States waiting for the background writer
+     * are found as well.
      */
     bool getFromCache (const uint256& hash, GameState& state) const;
 
+    /**
+     * Check whether the given state is one of the last minInMemory
+     * main-chain blocks.
+     */
+    bool isRecentMainChain (const uint256& hash, int height) const;
+
+    /**
+     * Mark states on disk as transient that older versions wrote at
+     * shutdown and would have removed with the next flush.  This is done
+     * once when the database is opened for the first time.
+     */
+    void markLegacyTransient ();
+
+    /**
+     * Return the memory used by the cache.  cs_cache must be held.
+     */
+    size_t cacheUsage () const;
+
     /**
      * Attempt to flush, which flushes if the cache is overly full.
      */
     void attemptFlush ()
     {
       AssertLockHeld (cs_cache);
-      if (!keepEverything && cache.size () > maxInMemory)
+      if (!keepEverything && cacheUsage () > maxCacheSize)
         flush (false);
     }
 
     /**
-     * Flush the in-memory cache to disk.  The minimum in-memory blocks
-     * are kept in memory, and the others are written to disk or discarded
-     * (depending on the keep-every-nth policy).  This also goes through
-     * the on-disk states and removes ones that do not fit the policy.
+     * Flush the in-memory cache to disk.  The recent main-chain states and
+     * the most recent side-branch states (as long as the cache stays below
+     * half of its limit) are kept in memory, and the others
+     * are written to disk or discarded (depending on the keep-every-nth
+     * policy).  This also removes states from disk that were only written
+     * there by the last shutdown.  It does not need cs_main.  The actual
+     * writing is done by the background writer, and this only blocks
+     * if it falls behind.
      * @param saveAll Store all in-memory cache to disk.  This is done
      *                when shutting down the node.
      */
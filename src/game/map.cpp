@@ -15,6 +15,9 @@
 
 #include <game/map.h>
 
+#include <algorithm>
+#include <cassert>
+
 // Note: modification of ObstacleMap or HarvestAreas will create a hard-fork
 // (even changing the order of HarvestAreas), because these values are used
 // to update the game state.
@@ -1079,3 +1082,47 @@ const int HarvestAreaSizes[NUM_HARVEST_AREAS] = { 440, 223, 47, 57, 425, 284, 52
 const int HarvestPortions[NUM_HARVEST_AREAS] = { 55, 40, 40, 40, 55, 40, 40, 40, 55, 40, 40, 40, 55, 40, 40, 40, 75, 100, };
 
 const int CrownSpawn[NUM_CROWN_LOCATIONS * 2] = { 103,95, 104,95, 105,95, 106,95, 394,95, 395,95, 396,95, 397,95, 102,96, 103,96, 104,96, 105,96, 106,96, 107,96, 393,96, 394,96, 395,96, 396,96, 397,96, 398,96, 102,97, 103,97, 104,97, 105,97, 106,97, 107,97, 393,97, 394,97, 395,97, 396,97, 397,97, 398,97, 102,98, 103,98, 104,98, 105,98, 106,98, 107,98, 173,98, 174,98, 175,98, 176,98, 324,98, 325,98, 326,98, 327,98, 393,98, 394,98, 395,98, 396,98, 397,98, 398,98, 102,99, 103,99, 104,99, 105,99, 106,99, 107,99, 172,99, 173,99, 174,99, 175,99, 176,99, 177,99, 323,99, 324,99, 325,99, 326,99, 327,99, 328,99, 393,99, 394,99, 395,99, 396,99, 397,99, 398,99, 103,100, 104,100, 105,100, 106,100, 172,100, 173,100, 174,100, 175,100, 176,100, 177,100, 323,100, 324,100, 325,100, 326,100, 327,100, 328,100, 394,100, 395,100, 396,100, 397,100, 172,101, 173,101, 174,101, 175,101, 176,101, 177,101, 323,101, 324,101, 325,101, 326,101, 327,101, 328,101, 172,102, 173,102, 174,102, 175,102, 176,102, 177,102, 323,102, 324,102, 325,102, 326,102, 327,102, 328,102, 173,103, 174,103, 175,103, 176,103, 324,103, 325,103, 326,103, 327,103, 107,171, 108,171, 109,171, 110,171, 390,171, 391,171, 392,171, 393,171, 106,172, 107,172, 108,172, 109,172, 110,172, 111,172, 389,172, 390,172, 391,172, 392,172, 393,172, 394,172, 106,173, 107,173, 108,173, 109,173, 110,173, 111,173, 389,173, 390,173, 391,173, 392,173, 393,173, 394,173, 106,174, 107,174, 108,174, 109,174, 110,174, 111,174, 389,174, 390,174, 391,174, 392,174, 393,174, 394,174, 106,175, 107,175, 108,175, 109,175, 110,175, 111,175, 389,175, 390,175, 391,175, 392,175, 393,175, 394,175, 107,176, 108,176, 109,176, 110,176, 390,176, 391,176, 392,176, 393,176, 249,246, 250,246, 251,246, 252,246, 248,247, 249,247, 250,247, 251,247, 252,247, 253,247, 248,248, 249,248, 250,248, 251,248, 252,248, 253,248, 248,249, 249,249, 250,249, 251,249, 252,249, 253,249, 248,250, 249,250, 250,250, 251,250, 252,250, 253,250, 249,251, 250,251, 251,251, 252,251, 107,324, 108,324, 109,324, 110,324, 390,324, 391,324, 392,324, 393,324, 106,325, 107,325, 108,325, 109,325, 110,325, 111,325, 389,325, 390,325, 391,325, 392,325, 393,325, 394,325, 106,326, 107,326, 108,326, 109,326, 110,326, 111,326, 389,326, 390,326, 391,326, 392,326, 393,326, 394,326, 106,327, 107,327, 108,327, 109,327, 110,327, 111,327, 389,327, 390,327, 391,327, 392,327, 393,327, 394,327, 106,328, 107,328, 108,328, 109,328, 110,328, 111,328, 389,328, 390,328, 391,328, 392,328, 393,328, 394,328, 107,329, 108,329, 109,329, 110,329, 390,329, 391,329, 392,329, 393,329, 173,397, 174,397, 175,397, 176,397, 324,397, 325,397, 326,397, 327,397, 172,398, 173,398, 174,398, 175,398, 176,398, 177,398, 323,398, 324,398, 325,398, 326,398, 327,398, 328,398, 172,399, 173,399, 174,399, 175,399, 176,399, 177,399, 323,399, 324,399, 325,399, 326,399, 327,399, 328,399, 103,400, 104,400, 105,400, 106,400, 172,400, 173,400, 174,400, 175,400, 176,400, 177,400, 323,400, 324,400, 325,400, 326,400, 327,400, 328,400, 394,400, 395,400, 396,400, 397,400, 102,401, 103,401, 104,401, 105,401, 106,401, 107,401, 172,401, 173,401, 174,401, 175,401, 176,401, 177,401, 323,401, 324,401, 325,401, 326,401, 327,401, 328,401, 393,401, 394,401, 395,401, 396,401, 397,401, 398,401, 102,402, 103,402, 104,402, 105,402, 106,402, 107,402, 173,402, 174,402, 175,402, 176,402, 324,402, 325,402, 326,402, 327,402, 393,402, 394,402, 395,402, 396,402, 397,402, 398,402, 102,403, 103,403, 104,403, 105,403, 106,403, 107,403, 393,403, 394,403, 395,403, 396,403, 397,403, 398,403, 102,404, 103,404, 104,404, 105,404, 106,404, 107,404, 393,404, 394,404, 395,404, 396,404, 397,404, 398,404, 103,405, 104,405, 105,405, 106,405, 394,405, 395,405, 396,405, 397,405, };
+
+namespace {
+
+std::bitset<MAP_WIDTH * MAP_HEIGHT> ComputeWalkableMap()
+{
+    std::bitset<MAP_WIDTH * MAP_HEIGHT> res;
+    for (int y = 0; y < MAP_HEIGHT; ++y)
+        for (int x = 0; x < MAP_WIDTH; ++x)
+            res[y * MAP_WIDTH + x] = (ObstacleMap[y][x] == 0);
+    return res;
+}
+
+std::bitset<MAP_WIDTH * MAP_HEIGHT> ComputeHeartDropMap()
+{
+    std::bitset<MAP_WIDTH * MAP_HEIGHT> res;
+    for (int y = 0; y < MAP_HEIGHT; ++y)
+        for (int x = 0; x < MAP_WIDTH; ++x)
+            res[y * MAP_WIDTH + x] = IsWalkable(x, y) && !IsOriginalSpawnArea(x, y);
+    return res;
+}
+
+// Collect the walkable tiles that have one of the SpawnMap flags set, or all
+// if flags is zero.  Going through them row by row yields them in the
+// order of Coord::operator<.
+std::vector<Coord> CollectWalkableTiles(unsigned char flags)
+{
+    std::vector<Coord> res;
+    for (int y = 0; y < MAP_HEIGHT; ++y)
+        for (int x = 0; x < MAP_WIDTH; ++x)
+            if (IsWalkable(x, y) && (flags == 0 || (SpawnMap[y][x] & flags)))
+                res.emplace_back(x, y);
+
+    assert(!res.empty() && std::is_sorted(res.begin(), res.end()));
+    return res;
+}
+
+} // anonymous namespace
+
+// These are initialised in order of definition, after the constant arrays.
+const std::bitset<MAP_WIDTH * MAP_HEIGHT> WalkableMap = ComputeWalkableMap();
+const std::bitset<MAP_WIDTH * MAP_HEIGHT> HeartDropMap = ComputeHeartDropMap();
+const std::vector<Coord> WalkableTiles = CollectWalkableTiles(0);
+const std::vector<Coord> PlayerSpawnTiles = CollectWalkableTiles(SPAWNMAPFLAG_PLAYER);
+const std::vector<Coord> BankSpawnTiles = CollectWalkableTiles(SPAWNMAPFLAG_BANK);
@@ -16,6 +16,11 @@
 #ifndef GAME_MAP_H
 #define GAME_MAP_H
 
+#include <game/common.h>
+
+#include <bitset>
+#include <vector>
+
 static const int MAP_WIDTH = 502;
 static const int MAP_HEIGHT = 502;
 
@@ -45,6 +50,25 @@ static const int CROWN_BONUS = 25;                    // Bonus for holding Crown
 // Locations where the crown can spawn when the crown holder enters spawn area (x,y pairs)
 extern const int CrownSpawn[NUM_CROWN_LOCATIONS * 2];
 
+// Tables derived from ObstacleMap and SpawnMap.  They are computed during
+// static initialisation, so that game steps can use them from any thread
+// without locking or a lazy fill on first use.
+
+// Walkability of the tiles packed into bits, indexed by y * MAP_WIDTH + x
+extern const std::bitset<MAP_WIDTH * MAP_HEIGHT> WalkableMap;
+
+// Tiles where hearts can be dropped (walkable and outside of the original
+// spawn area), indexed like WalkableMap
+extern const std::bitset<MAP_WIDTH * MAP_HEIGHT> HeartDropMap;
+
+// All walkable tiles, and the walkable tiles where players can spawn and
+// where banks can appear with FORK_TIMESAVE.  They are sorted according to
+// Coord::operator<, which is part of consensus since random numbers are
+// used to index into them.
+extern const std::vector<Coord> WalkableTiles;
+extern const std::vector<Coord> PlayerSpawnTiles;
+extern const std::vector<Coord> BankSpawnTiles;
+
 inline bool IsInsideMap(int x, int y)
 {
     return x >= 0 && x < MAP_WIDTH && y >= 0 && y < MAP_HEIGHT;
@@ -52,7 +76,7 @@ inline bool IsInsideMap(int x, int y)
 
 inline bool IsWalkable(int x, int y)
 {
-    return ObstacleMap[y][x] == 0;
+    return WalkableMap[y * MAP_WIDTH + x];
 }
 
 inline bool IsOriginalSpawnArea(int x, int y)
@@ -61,4 +85,9 @@ inline bool IsOriginalSpawnArea(int x, int y)
         || ((y == 0 || y == MAP_HEIGHT - 1) && (x < SPAWN_AREA_LENGTH || x >= MAP_WIDTH - SPAWN_AREA_LENGTH));
 }
 
+inline bool IsHeartDropTile(int x, int y)
+{
+    return HeartDropMap[y * MAP_WIDTH + x];
+}
+
 #endif
@@ -0,0 +1,72 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <game/region.h>
+
+#include <game/map.h>
+#include <game/state.h>
+
+#include <algorithm>
+
+bool
+MapRegion::ClipToMap ()
+{
+  if (max.x < 0 || max.y < 0 || min.x >= MAP_WIDTH || min.y >= MAP_HEIGHT)
+    return false;
+
+  min.x = std::max (min.x, 0);
+  min.y = std::max (min.y, 0);
+  max.x = std::min (max.x, MAP_WIDTH - 1);
+  max.y = std::min (max.y, MAP_HEIGHT - 1);
+  return true;
+}
+
+CharacterGrid::CharacterGrid (std::shared_ptr<const GameState> s)
+  : state(std::move (s)),
+    cellsX((MAP_WIDTH + CELL_SIZE - 1) / CELL_SIZE),
+    cellsY((MAP_HEIGHT + CELL_SIZE - 1) / CELL_SIZE),
+    cells(cellsX * cellsY)
+{
+  for (const auto& p : state->players)
+    for (const auto& c : p.second.characters)
+      {
+        const Coord& pos = c.second.coord;
+        cells[CellY (pos.y) * cellsX + CellX (pos.x)].emplace_back (
+            CharacterID (p.first, c.first), &c.second);
+      }
+}
+
+int
+CharacterGrid::CellX (const int x) const
+{
+  return std::min (std::max (x / CELL_SIZE, 0), cellsX - 1);
+}
+
+int
+CharacterGrid::CellY (const int y) const
+{
+  return std::min (std::max (y / CELL_SIZE, 0), cellsY - 1);
+}
+
+void
+CharacterGrid::Query (const MapRegion& r, std::vector<Entry>& res) const
+{
+  res.clear ();
+  for (int cy = CellY (r.min.y); cy <= CellY (r.max.y); ++cy)
+    for (int cx = CellX (r.min.x); cx <= CellX (r.max.x); ++cx)
+      for (const auto& e : cells[cy * cellsX + cx])
+        if (r.Contains (e.second->coord))
+          res.push_back (e);
+}
@@ -0,0 +1,147 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GAME_REGION_H
+#define GAME_REGION_H
+
+#include <game/common.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+struct CharacterState;
+struct GameState;
+
+/**
+ * A rectangular region of the map.  Both corners are included.
+ */
+struct MapRegion
+{
+
+  Coord min;
+  Coord max;
+
+  MapRegion (const Coord& a, const Coord& b)
+    : min(std::min (a.x, b.x), std::min (a.y, b.y)),
+      max(std::max (a.x, b.x), std::max (a.y, b.y))
+  {}
+
+  inline bool
+  Contains (const Coord& c) const
+  {
+    return c.x >= min.x && c.x <= max.x && c.y >= min.y && c.y <= max.y;
+  }
+
+  /**
+   * Clip the region to the map.  Returns false (and leaves the region
+   * unchanged) if it does not overlap the map at all.
+   */
+  bool ClipToMap ();
+
+};
+
+/* Key of the entries in the Coord-indexed containers of the game state.  */
+inline const Coord&
+RegionKey (const Coord& c)
+{
+  return c;
+}
+template<typename T>
+  inline const Coord&
+  RegionKey (const std::pair<const Coord, T>& entry)
+{
+  return entry.first;
+}
+
+/**
+ * Call f for all entries of a Coord-indexed map or set (like the loot,
+ * hearts and banks of the game state) that are within the region.  Since
+ * Coord is ordered by rows, this only visits the entries within the region
+ * (plus one per row).
+ */
+template<typename Container, typename Func>
+  void
+  ForEachInRegion (const Container& c, const MapRegion& region, Func f)
+{
+  /* Only rows on the map can have entries.  Clipping also bounds the
+     loop for arbitrary (user-supplied) corners.  */
+  MapRegion r = region;
+  if (!r.ClipToMap ())
+    return;
+
+  for (int y = r.min.y; y <= r.max.y; ++y)
+    for (auto it = c.lower_bound (Coord (r.min.x, y)); it != c.end (); ++it)
+      {
+        const Coord& pos = RegionKey (*it);
+        if (pos.y != y || pos.x > r.max.x)
+          break;
+        f (*it);
+      }
+}
+
+/**
+ * Spatial index of the characters in a game state, dividing the map into
+ * a grid of square cells.  It holds a reference to the game state, so that
+ * the character pointers it returns stay valid.
+ */
+class CharacterGrid
+{
+
+public:
+
+  typedef std::pair<CharacterID, const CharacterState*> Entry;
+
+private:
+
+  /** Side length of the grid cells.  */
+  static const int CELL_SIZE = 16;
+
+  std::shared_ptr<const GameState> state;
+
+  /** Number of cells per row and column.  */
+  int cellsX, cellsY;
+  /** The characters in each cell, row by row.  */
+  std::vector<std::vector<Entry>> cells;
+
+  /** Return the cell index for a coordinate, clamped to the grid.  */
+  int CellX (int x) const;
+  int CellY (int y) const;
+
+public:
+
+  explicit CharacterGrid (std::shared_ptr<const GameState> s);
+
+  CharacterGrid (const CharacterGrid&) = delete;
+  void operator= (const CharacterGrid&) = delete;
+
+  inline const GameState&
+  GetState () const
+  {
+    return *state;
+  }
+
+  /**
+   * Find all characters within the region.  They are returned in no
+   * particular order.
+   */
+  void Query (const MapRegion& r, std::vector<Entry>& res) const;
+
+};
+
+#endif // GAME_REGION_H
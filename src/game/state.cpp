@@ -18,12 +18,11 @@
 #include <core_io.h>
 #include <game/map.h>
 #include <game/move.h>
+#include <memusage.h>
 #include <rpc/server.h>
 #include <util.h>
 #include <utilstrencodings.h>
 
-#include <functional>
-
 namespace
 {
 
@@ -57,20 +56,6 @@ IsWalkableCoord (const Coord &c)
     return IsWalkable(c.x, c.y);
 }
 
-/**
- * Keep a set of walkable tiles.  This is used for random selection of
- * one of them for spawning / dynamic bank purposes.  Note that it is
- * important how they are ordered (according to Coord::operator<) in order
- * to reach consensus on the game state.
- *
- * This is filled in from IsWalkable() whenever it is empty (on startup).  It
- * does not ever change.
- */
-std::vector<Coord> walkableTiles;
-// for FORK_TIMESAVE -- 2 more sets of walkable tiles
-std::vector<Coord> walkableTiles_ts_players;
-std::vector<Coord> walkableTiles_ts_banks;
-
 /* Calculate carrying capacity.  This is where it is basically defined.
    It depends on the block height (taking forks changing it into account)
    and possibly properties of the player.  Returns -1 if the capacity
@@ -128,50 +113,6 @@ DropHeart (const GameState& state)
   return state.nHeight % heartEvery == 0;
 }
 
-/* Fills in a walkableTiles array, using the passed predicate in addition
-   to the general IsWalkable() function to decide which coordinates should
-   be put into the list.  */
-void
-FillWalkableArray (std::vector<Coord>& tiles,
-                   const std::function<bool(int, int)>& predicate)
-{
-  if (tiles.empty ())
-    {
-      for (int x = 0; x < MAP_WIDTH; ++x)
-        for (int y = 0; y < MAP_HEIGHT; ++y)
-          if (IsWalkable (x, y) && predicate (x, y))
-            tiles.push_back (Coord (x, y));
-
-      /* Do not forget to sort in the order defined by operator<!  */
-      std::sort (tiles.begin (), tiles.end ());
-    }
-
-  assert (!tiles.empty ());
-}
-
-/* Ensure that walkableTiles is filled.  */
-void
-FillWalkableTiles ()
-{
-  FillWalkableArray (walkableTiles_ts_players,
-    [] (int x, int y)
-      {
-        return SpawnMap[y][x] & SPAWNMAPFLAG_PLAYER;
-      });
-
-  FillWalkableArray (walkableTiles_ts_banks,
-    [] (int x, int y)
-      {
-        return SpawnMap[y][x] & SPAWNMAPFLAG_BANK;
-      });
-
-  FillWalkableArray (walkableTiles,
-    [] (int x, int y)
-      {
-        return true;
-      });
-}
-
 } // anonymous namespace
 
 /* Return the minimum necessary amount of locked coins.  This replaces the
@@ -545,10 +486,8 @@ CharacterState::Spawn (const GameState& state, int color, RandomGenerator &rnd)
   // less possible player spawn tiles
   if (state.ForkInEffect (FORK_TIMESAVE))
   {
-      FillWalkableTiles ();
-
-      const int pos = rnd.GetIntRnd (walkableTiles_ts_players.size ());
-      coord = walkableTiles_ts_players[pos];
+      const int pos = rnd.GetIntRnd (PlayerSpawnTiles.size ());
+      coord = PlayerSpawnTiles[pos];
 
       dir = rnd.GetIntRnd (1, 8);
       if (dir >= 5)
@@ -558,10 +497,8 @@ CharacterState::Spawn (const GameState& state, int color, RandomGenerator &rnd)
   /* Pick a random walkable spawn location after the life-steal fork.  */
   else if (state.ForkInEffect (FORK_LIFESTEAL))
     {
-      FillWalkableTiles ();
-
-      const int pos = rnd.GetIntRnd (walkableTiles.size ());
-      coord = walkableTiles[pos];
+      const int pos = rnd.GetIntRnd (WalkableTiles.size ());
+      coord = WalkableTiles[pos];
 
       dir = rnd.GetIntRnd (1, 8);
       if (dir >= 5)
@@ -839,6 +776,26 @@ PlayerState::CanSpawnCharacter() const
           && next_character_index < MAX_CHARACTERS_PER_PLAYER_TOTAL;
 }
 
+size_t
+CharacterState::DynamicMemoryUsage () const
+{
+  return memusage::DynamicUsage (waypoints);
+}
+
+size_t
+PlayerState::DynamicMemoryUsage () const
+{
+  size_t res = memusage::DynamicUsage (characters);
+  for (const auto& c : characters)
+    res += c.second.DynamicMemoryUsage ();
+
+  res += memusage::DynamicUsage (message);
+  res += memusage::DynamicUsage (address);
+  res += memusage::DynamicUsage (addressLock);
+
+  return res;
+}
+
 UniValue PlayerState::ToJsonValue(int crown_index, bool dead /* = false*/) const
 {
   UniValue obj(UniValue::VOBJ);
@@ -953,6 +910,27 @@ GameState::GameState(const Consensus::Params& p)
     SetOriginalBanks (banks);
 }
 
+size_t
+GameState::DynamicMemoryUsage () const
+{
+  size_t res = 0;
+
+  for (const PlayerStateMap* m : {&players, &dead_players_chat})
+    {
+      res += memusage::DynamicUsage (*m);
+      for (const auto& p : *m)
+        res += memusage::DynamicUsage (p.first)
+                + p.second.DynamicMemoryUsage ();
+    }
+
+  res += memusage::DynamicUsage (loot);
+  res += memusage::DynamicUsage (hearts);
+  res += memusage::DynamicUsage (banks);
+  res += memusage::DynamicUsage (crownHolder.player);
+
+  return res;
+}
+
 UniValue GameState::ToJsonValue() const
 {
     UniValue obj(UniValue::VOBJ);
@@ -1271,6 +1249,23 @@ GameState::GetCoinsOnMap () const
 
 void GameState::CollectHearts(RandomGenerator &rnd)
 {
+    /* There are no hearts anymore after the life-steal fork, so do not
+       go through all characters in that case.  */
+    if (hearts.empty())
+        return;
+
+    /* Mark the columns and rows that contain hearts.  A character can only
+       be on a heart if both its column and row are marked, which rules out
+       most characters without a lookup in the hearts set.  */
+    std::bitset<MAP_WIDTH> heartColumns;
+    std::bitset<MAP_HEIGHT> heartRows;
+    for (const auto& h : hearts)
+    {
+        assert(IsInsideMap(h.x, h.y));
+        heartColumns.set(h.x);
+        heartRows.set(h.y);
+    }
+
     std::map<Coord, std::vector<PlayerState*> > playersOnHeartTile;
     for (std::map<PlayerID, PlayerState>::iterator mi = players.begin(); mi != players.end(); mi++)
     {
@@ -1279,10 +1274,12 @@ void GameState::CollectHearts(RandomGenerator &rnd)
             continue;
         for (const auto& pc : pl->characters)
           {
-            const CharacterState &ch = pc.second;
+            const Coord &c = pc.second.coord;
+            if (!IsInsideMap(c.x, c.y) || !heartColumns[c.x] || !heartRows[c.y])
+                continue;
 
-            if (hearts.count(ch.coord))
-                playersOnHeartTile[ch.coord].push_back(pl);
+            if (hearts.count(c))
+                playersOnHeartTile[c].push_back(pl);
           }
     }
     for (std::map<Coord, std::vector<PlayerState*> >::iterator mi = playersOnHeartTile.begin(); mi != playersOnHeartTile.end(); mi++)
@@ -1651,7 +1648,7 @@ GameState::UpdateBanks (RandomGenerator& rng)
         assert (b.second >= 1);
 
         // reset all banks as to not break things,
-        // e.g. "assert (optionsSet.count (b.first) == 1)"
+        // e.g. the assertion that all banks are on a bank spawn tile
         if (param->rules->IsForkHeight (FORK_TIMESAVE, nHeight))
           continue;
 
@@ -1667,48 +1664,26 @@ GameState::UpdateBanks (RandomGenerator& rng)
 
   assert (newBanks.size () <= DYNBANKS_NUM_BANKS);
 
-  // less possible bank spawn tiles
-  if (ForkInEffect (FORK_TIMESAVE))
-  {
-    FillWalkableTiles ();
-    std::set<Coord> optionsSet(walkableTiles_ts_banks.begin (), walkableTiles_ts_banks.end ());
-    for (const auto& b : newBanks)
+  /* The options for new banks are the tiles from the respective list (with
+     less possible bank spawn tiles after FORK_TIMESAVE) where there is no
+     bank yet.  Both lists are sorted, so this is a simple merge.  All
+     existing banks must be on one of the tiles.  */
+  const std::vector<Coord>& tiles
+    = ForkInEffect (FORK_TIMESAVE) ? BankSpawnTiles : WalkableTiles;
+  std::vector<Coord> options;
+  options.reserve (tiles.size ());
+  auto bankIt = newBanks.begin ();
+  for (const auto& c : tiles)
     {
-      assert (optionsSet.count (b.first) == 1);
-      optionsSet.erase (b.first);
-    }
-    assert (optionsSet.size () + newBanks.size () == walkableTiles_ts_banks.size ());
-
-    std::vector<Coord> options(optionsSet.begin (), optionsSet.end ());
-    for (unsigned cnt = newBanks.size (); cnt < DYNBANKS_NUM_BANKS; ++cnt)
-    {
-      const int ind = rng.GetIntRnd (options.size ());
-      const int life = rng.GetIntRnd (DYNBANKS_MIN_LIFE, DYNBANKS_MAX_LIFE);
-      const Coord& c = options[ind];
-
-      assert (newBanks.count (c) == 0);
-      newBanks.insert (std::make_pair (c, life));
-
-      /* Do not use a silly trick like swapping in the last element.
-         We want to keep the array ordered at all times.  The order is
-         important with respect to consensus, and this makes the consensus
-         protocol "clearer" to describe.  */
-      options.erase (options.begin () + ind);
-    }
-  }
-  else // pre-fork
-  {
-    FillWalkableTiles ();
-    std::set<Coord> optionsSet(walkableTiles.begin (), walkableTiles.end ());
-    for (const auto& b : newBanks)
-    {
-      assert (optionsSet.count (b.first) == 1);
-      optionsSet.erase (b.first);
+      if (bankIt != newBanks.end () && bankIt->first == c)
+        ++bankIt;
+      else
+        options.push_back (c);
     }
-    assert (optionsSet.size () + newBanks.size () == walkableTiles.size ());
+  assert (bankIt == newBanks.end ());
+  assert (options.size () + newBanks.size () == tiles.size ());
 
-    std::vector<Coord> options(optionsSet.begin (), optionsSet.end ());
-    for (unsigned cnt = newBanks.size (); cnt < DYNBANKS_NUM_BANKS; ++cnt)
+  for (unsigned cnt = newBanks.size (); cnt < DYNBANKS_NUM_BANKS; ++cnt)
     {
       const int ind = rng.GetIntRnd (options.size ());
       const int life = rng.GetIntRnd (DYNBANKS_MIN_LIFE, DYNBANKS_MAX_LIFE);
@@ -1723,7 +1698,6 @@ GameState::UpdateBanks (RandomGenerator& rng)
          protocol "clearer" to describe.  */
       options.erase (options.begin () + ind);
     }
-  }
 
   banks.swap (newBanks);
   assert (banks.size () == DYNBANKS_NUM_BANKS);
@@ -1929,12 +1903,15 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
     {
         assert (!outState.ForkInEffect (FORK_LIFESTEAL));
 
+        /* The number of random numbers drawn here is part of consensus,
+           so the tile must still be found by rejection sampling.  The
+           precomputed HeartDropMap makes each check a single bit test.  */
         Coord heart;
         do
         {
             heart.x = rnd.GetIntRnd(MAP_WIDTH);
             heart.y = rnd.GetIntRnd(MAP_HEIGHT);
-        } while (!IsWalkableCoord (heart) || IsOriginalSpawnAreaCoord (heart));
+        } while (!IsHeartDropTile (heart.x, heart.y));
         outState.hearts.insert(heart);
     }
 
@@ -309,6 +309,10 @@ struct CharacterState
     CAmount CollectLoot (LootInfo newLoot, int nHeight, CAmount carryCap);
 
     UniValue ToJsonValue(bool has_crown) const;
+
+    /* Return the heap memory used by this character (not including the
+       object itself).  */
+    size_t DynamicMemoryUsage () const;
 };
 
 struct PlayerState
@@ -365,6 +369,10 @@ struct PlayerState
     void SpawnCharacter(const GameState& state, RandomGenerator &rnd);
     bool CanSpawnCharacter() const;
     UniValue ToJsonValue(int crown_index, bool dead = false) const;
+
+    /* Return the heap memory used by this player, including all
+       characters (not including the object itself).  */
+    size_t DynamicMemoryUsage () const;
 };
 
 struct GameState
@@ -436,6 +444,11 @@ struct GameState
     
     UniValue ToJsonValue() const;
 
+    /* Return the heap memory used by this game state (not including the
+       object itself).  This is used to limit the size of the game db's
+       in-memory cache.  */
+    size_t DynamicMemoryUsage () const;
+
     inline bool
     ForkInEffect (Fork type) const
     {
@@ -144,6 +144,54 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Reply with a JSON value, serialising it straight into the request's
+ * output buffer.  A JSON-RPC reply object is written around the result if
+ * id is given.
+ */
+static void JSONStreamReply(HTTPRequest* req, const UniValue& result, const UniValue* id)
+{
+    JSONStreamWriter writer([req](const char* data, size_t len) {
+        req->AppendReplyBody(data, len);
+    });
+    if (id) {
+        JSONRPCWriteReply(writer, result, NullUniValue, *id);
+    } else {
+        writer.Write(result);
+        writer.WriteRaw("\n");
+    }
+    writer.Flush();
+
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK);
+}
+
+/** Execute a single JSON-RPC request and reply to it, or park the request if
+ * the method would have to wait.  In that case, it is executed again on
+ * the next wake-up.
+ */
+static bool HTTPReq_JSONRPCExec(HTTPRequest* req, const JSONRPCRequest& jreq)
+{
+    try {
+        UniValue result = tableRPC.execute(jreq);
+
+        // Send reply
+        JSONStreamReply(req, result, &jreq.id);
+    } catch (const RPCParkRequest& park) {
+        JSONRPCRequest resumed = jreq;
+        resumed.params = park.params;
+        req->Park([resumed](HTTPRequest* parked, const std::string&) {
+            return HTTPReq_JSONRPCExec(parked, resumed);
+        });
+    } catch (const UniValue& objError) {
+        JSONErrorReply(req, objError, jreq.id);
+        return false;
+    } catch (const std::exception& e) {
+        JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        return false;
+    }
+    return true;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -183,24 +231,17 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // Set the URI
         jreq.URI = req->GetURI();
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
-
-            UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            jreq.fParkable = true;
+            return HTTPReq_JSONRPCExec(req, jreq);
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(jreq, valRequest.get_array());
+            JSONStreamReply(req, JSONRPCExecBatch(jreq, valRequest.get_array()), nullptr);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
-
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
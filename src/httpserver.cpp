@@ -41,6 +41,10 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+class HTTPWorkItem;
+static uint64_t GetParkGeneration();
+static void ParkWorkItem(std::unique_ptr<HTTPWorkItem> item, uint64_t generation);
+
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
 {
@@ -51,7 +55,14 @@ public:
     }
     void operator()() override
     {
+        // Wake-ups that happen while the handler runs must not be missed if
+        // it parks the request.
+        const uint64_t generation = GetParkGeneration();
         func(req.get(), path);
+        HTTPRequestHandler parked = req->TakeParkedHandler();
+        if (parked) {
+            ParkWorkItem(std::unique_ptr<HTTPWorkItem>(new HTTPWorkItem(std::move(req), path, parked)), generation);
+        }
     }
 
     std::unique_ptr<HTTPRequest> req;
@@ -85,11 +96,13 @@ public:
     ~WorkQueue()
     {
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Enqueue a work item.  If force is set, the depth limit is ignored (for
+     * items that have been accepted before).
+     */
+    bool Enqueue(WorkItem* item, bool force = false)
     {
         std::unique_lock<std::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
+        if (!force && queue.size() >= maxDepth) {
             return false;
         }
         queue.emplace_back(std::unique_ptr<WorkItem>(item));
@@ -148,6 +161,56 @@ static WorkQueue<HTTPClosure>* workQueue = nullptr;
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 std::vector<evhttp_bound_socket *> boundSockets;
+//! Protects parked requests and the park generation
+static std::mutex cs_parked;
+//! Requests parked until the next wake-up, which do not occupy a worker thread
+static std::vector<std::unique_ptr<HTTPWorkItem>> parkedRequests;
+//! Number of wake-ups so far
+static uint64_t parkGeneration = 0;
+//! Set when the server is interrupted, after which requests are not parked
+static bool parkingStopped = false;
+
+static uint64_t GetParkGeneration()
+{
+    std::lock_guard<std::mutex> lock(cs_parked);
+    return parkGeneration;
+}
+
+/** Park a work item, or requeue it immediately if a wake-up happened since
+ * its handler was started at the given generation.
+ */
+static void ParkWorkItem(std::unique_ptr<HTTPWorkItem> item, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(cs_parked);
+    if (parkingStopped) {
+        item->req->WriteReply(HTTP_SERVUNAVAIL);
+        return;
+    }
+    if (generation == parkGeneration) {
+        parkedRequests.push_back(std::move(item));
+        return;
+    }
+    assert(workQueue);
+    if (workQueue->Enqueue(item.get(), true))
+        item.release();
+}
+
+void WakeParkedHTTPRequests()
+{
+    std::vector<std::unique_ptr<HTTPWorkItem>> woken;
+    {
+        std::lock_guard<std::mutex> lock(cs_parked);
+        ++parkGeneration;
+        woken.swap(parkedRequests);
+    }
+    if (!woken.empty()) {
+        LogPrint(BCLog::HTTP, "Waking %u parked requests\n", woken.size());
+    }
+    for (auto& item : woken) {
+        if (workQueue && workQueue->Enqueue(item.get(), true))
+            item.release();
+    }
+}
 
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
@@ -451,6 +514,15 @@ void InterruptHTTPServer()
     }
     if (workQueue)
         workQueue->Interrupt();
+    {
+        // Parked requests would not be woken up anymore
+        std::lock_guard<std::mutex> lock(cs_parked);
+        parkingStopped = true;
+        for (auto& item : parkedRequests) {
+            item->req->WriteReply(HTTP_SERVUNAVAIL);
+        }
+        parkedRequests.clear();
+    }
 }
 
 void StopHTTPServer()
@@ -575,6 +647,14 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+void HTTPRequest::AppendReplyBody(const char* data, size_t len)
+{
+    assert(!replySent && req);
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    evbuffer_add(evb, data, len);
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -607,6 +687,19 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = nullptr; // transferred back to main thread
 }
 
+void HTTPRequest::Park(const HTTPRequestHandler& handler)
+{
+    assert(!replySent && req && !parkedHandler);
+    parkedHandler = handler;
+}
+
+HTTPRequestHandler HTTPRequest::TakeParkedHandler()
+{
+    HTTPRequestHandler res;
+    res.swap(parkedHandler);
+    return res;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -46,6 +46,12 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Wake up all parked HTTP requests (see HTTPRequest::Park).  Their handlers
+ * are run again on the worker threads.  This is called when the chain tip
+ * changes.
+ */
+void WakeParkedHTTPRequests();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -59,6 +65,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    HTTPRequestHandler parkedHandler;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -105,6 +112,12 @@ public:
      */
     void WriteHeader(const std::string& hdr, const std::string& value);
 
+    /**
+     * Append data to the body of the reply, for replies that are generated
+     * piecewise.  The data is sent together with strReply by WriteReply.
+     */
+    void AppendReplyBody(const char* data, size_t len);
+
     /**
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
@@ -114,6 +127,23 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Park the request instead of replying to it, for long-polls that wait
+     * for an event.  A parked request does not occupy a worker thread.  When
+     * woken up by WakeParkedHTTPRequests, handler is called for it on a worker
+     * thread.  It may reply or park the request again.
+     *
+     * @note Call this instead of WriteReply, and only from the request's
+     * handler.  The body has been consumed already and is not available to
+     * the new handler.
+     */
+    void Park(const HTTPRequestHandler& handler);
+
+    /** Return the handler set by Park and reset it, or an empty handler if
+     * the request has not been parked.
+     */
+    HTTPRequestHandler TakeParkedHandler();
 };
 
 /** Event handler closure.
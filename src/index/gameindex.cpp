@@ -0,0 +1,304 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/gameindex.h>
+
+#include <compat/endian.h>
+#include <game/common.h>
+#include <game/state.h>
+#include <game/tx.h>
+#include <names/common.h>
+#include <script/names.h>
+#include <util.h>
+#include <validation.h>
+
+#include <cassert>
+
+constexpr char DB_GAME_EVENT = 'e';
+
+std::unique_ptr<GameIndex> g_gameindex;
+
+namespace {
+
+/**
+ * Database key for an event.  The name is followed by big-endian height and
+ * sequence numbers, so that iterating the database returns the events of a
+ * player in chain order.
+ */
+struct GameEventKey {
+    char key;
+    valtype name;
+    uint32_t height;
+    uint32_t seq;
+
+    GameEventKey() : key(DB_GAME_EVENT), height(0), seq(0) {}
+    GameEventKey(const valtype& n, uint32_t h, uint32_t s) : key(DB_GAME_EVENT), name(n), height(h), seq(s) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        s << name;
+        const uint32_t beHeight = htobe32(height);
+        s.write(reinterpret_cast<const char*>(&beHeight), sizeof(beHeight));
+        const uint32_t beSeq = htobe32(seq);
+        s.write(reinterpret_cast<const char*>(&beSeq), sizeof(beSeq));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> name;
+        uint32_t be;
+        s.read(reinterpret_cast<char*>(&be), sizeof(be));
+        height = be32toh(be);
+        s.read(reinterpret_cast<char*>(&be), sizeof(be));
+        seq = be32toh(be);
+    }
+};
+
+/** Read a small unsigned integer as pushed by CreateGameTransactions.  */
+bool GetScriptUint(const CScript& script, CScript::const_iterator& pc, int& res)
+{
+    opcodetype opcode;
+    valtype vch;
+    if (!script.GetOp(pc, opcode, vch))
+        return false;
+
+    if (opcode >= OP_1 && opcode <= OP_16) {
+        res = opcode - OP_1 + 1;
+        return true;
+    }
+
+    res = 0;
+    for (unsigned i = 0; i < vch.size(); ++i)
+        res += (1 << (i * 8)) * vch[i];
+    return true;
+}
+
+/** Decode a killed-by game tx input into the victim's and killers' events.  */
+bool AddKillEvents(const CScript& scriptSig, const CGameEvent& base, GameEventMap& events)
+{
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    valtype vchVictim;
+    if (!scriptSig.GetOp(pc, opcode, vchVictim) || !scriptSig.GetOp(pc, opcode))
+        return false;
+    const std::string victim = ValtypeToString(vchVictim);
+
+    CGameEvent death(base);
+    death.type = CGameEvent::DEATH;
+    switch (opcode - OP_1 + 1) {
+    case GAMEOP_KILLED_BY:
+    {
+        valtype vchKiller;
+        while (scriptSig.GetOp(pc, opcode, vchKiller))
+            death.others.push_back(ValtypeToString(vchKiller));
+        death.reason = death.others.empty() ? KilledByInfo::KILLED_SPAWN
+                                            : KilledByInfo::KILLED_DESTRUCT;
+        break;
+    }
+
+    case GAMEOP_KILLED_POISON:
+        death.reason = KilledByInfo::KILLED_POISON;
+        break;
+
+    default:
+        return false;
+    }
+
+    for (const auto& killer : death.others) {
+        CharacterID chid;
+        if (!chid.FromString(killer))
+            return false;
+
+        CGameEvent kill(base);
+        kill.type = CGameEvent::KILL;
+        kill.reason = KilledByInfo::KILLED_DESTRUCT;
+        kill.character = chid.index;
+        kill.others.push_back(victim);
+        events[chid.player].push_back(kill);
+    }
+    events[victim].push_back(death);
+
+    return true;
+}
+
+/** Decode a bounty game tx input into the player's event.  */
+bool AddBountyEvent(const CScript& scriptSig, const CAmount amount, const CGameEvent& base,
+                    GameEventMap& events)
+{
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    valtype vchName;
+    if (!scriptSig.GetOp(pc, opcode, vchName) || !scriptSig.GetOp(pc, opcode))
+        return false;
+
+    CGameEvent ev(base);
+    switch (opcode - OP_1 + 1) {
+    case GAMEOP_COLLECTED_BOUNTY:
+        ev.type = CGameEvent::BOUNTY;
+        break;
+    case GAMEOP_REFUND:
+        ev.type = CGameEvent::REFUND;
+        break;
+    default:
+        return false;
+    }
+    if (!GetScriptUint(scriptSig, pc, ev.character))
+        return false;
+    ev.amount = amount;
+
+    events[ValtypeToString(vchName)].push_back(ev);
+    return true;
+}
+
+} // anonymous namespace
+
+std::string CGameEvent::GetTypeString() const
+{
+    switch (type) {
+    case SPAWN: return "spawn";
+    case DEATH: return "death";
+    case KILL: return "kill";
+    case BOUNTY: return "bounty";
+    case REFUND: return "refund";
+    default: return "unknown";
+    }
+}
+
+void ExtractGameEvents(const CBlock& block, const CBlockIndex* pindex,
+                       const std::vector<CTransactionRef>& vGameTx,
+                       GameEventMap& events)
+{
+    events.clear();
+
+    CGameEvent base;
+    base.hashBlock = pindex->GetBlockHash();
+    base.nHeight = pindex->nHeight;
+
+    for (const auto& tx : block.vtx) {
+        for (const auto& txout : tx->vout) {
+            const CNameScript op(txout.scriptPubKey);
+            if (!op.isNameOp() || op.getNameOp() != OP_NAME_FIRSTUPDATE)
+                continue;
+
+            CGameEvent ev(base);
+            ev.type = CGameEvent::SPAWN;
+            ev.txid = tx->GetHash();
+            ev.character = 0;
+            events[ValtypeToString(op.getOpName())].push_back(ev);
+        }
+    }
+
+    for (const auto& tx : vGameTx) {
+        base.txid = tx->GetHash();
+        for (unsigned i = 0; i < tx->vin.size(); ++i) {
+            const CScript& scriptSig = tx->vin[i].scriptSig;
+            bool ok;
+            if (tx->IsBountyTx()) {
+                assert(i < tx->vout.size());
+                ok = AddBountyEvent(scriptSig, tx->vout[i].nValue, base, events);
+            } else {
+                ok = AddKillEvents(scriptSig, base, events);
+            }
+            if (!ok) {
+                LogPrintf("%s: could not decode game tx %s input %u\n",
+                          __func__, base.txid.GetHex(), i);
+            }
+        }
+    }
+}
+
+/** Access to the game index database (indexes/game/) */
+class GameIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Write the events of a block.
+    bool WriteEvents(int height, const GameEventMap& events);
+
+    /// Read events of a player, starting at the given height.  Events not
+    /// in the current main chain are skipped.
+    bool ReadEvents(const std::string& name, int from_height, size_t count,
+                    std::vector<CGameEvent>& events, int& next_height) const;
+};
+
+GameIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "game", n_cache_size, f_memory, f_wipe)
+{}
+
+bool GameIndex::DB::WriteEvents(int height, const GameEventMap& events)
+{
+    /* Entries left over from a block at the same height that has been
+       reorged out are not removed.  They are recognised and skipped when
+       reading by their block hash.  */
+    CDBBatch batch(*this);
+    for (const auto& entry : events) {
+        const valtype name = ValtypeFromString(entry.first);
+        for (unsigned i = 0; i < entry.second.size(); ++i) {
+            batch.Write(GameEventKey(name, height, i), entry.second[i]);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+bool GameIndex::DB::ReadEvents(const std::string& name, int from_height, size_t count,
+                               std::vector<CGameEvent>& events, int& next_height) const
+{
+    events.clear();
+    next_height = -1;
+
+    const valtype vchName = ValtypeFromString(name);
+    std::unique_ptr<CDBIterator> pcursor(const_cast<DB&>(*this).NewIterator());
+    pcursor->Seek(GameEventKey(vchName, std::max(from_height, 0), 0));
+
+    LOCK(cs_main);
+    for (; pcursor->Valid(); pcursor->Next()) {
+        GameEventKey key;
+        if (!pcursor->GetKey(key) || key.key != DB_GAME_EVENT || key.name != vchName)
+            break;
+
+        const int height = key.height;
+        if (events.size() >= count && events.back().nHeight != height) {
+            next_height = height;
+            break;
+        }
+
+        CGameEvent ev;
+        if (!pcursor->GetValue(ev)) {
+            return error("%s: failed to read game event", __func__);
+        }
+
+        const CBlockIndex* pindex = chainActive[height];
+        if (pindex == nullptr || pindex->GetBlockHash() != ev.hashBlock)
+            continue;
+
+        events.push_back(ev);
+    }
+
+    return true;
+}
+
+GameIndex::GameIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<GameIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+GameIndex::~GameIndex() {}
+
+bool GameIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex,
+                           const std::vector<CTransactionRef>& vGameTx)
+{
+    GameEventMap events;
+    ExtractGameEvents(block, pindex, vGameTx, events);
+    return m_db->WriteEvents(pindex->nHeight, events);
+}
+
+BaseIndex::DB& GameIndex::GetDB() const { return *m_db; }
+
+bool GameIndex::FindPlayerEvents(const std::string& name, int from_height, size_t count,
+                                 std::vector<CGameEvent>& events, int& next_height) const
+{
+    return m_db->ReadEvents(name, from_height, count, events, next_height);
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_GAMEINDEX_H
+#define BITCOIN_INDEX_GAMEINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Default for -gameindex.  */
+static const bool DEFAULT_GAMEINDEX = false;
+/** Maximum database cache size for the game index in MiB.  */
+static const int64_t nMaxGameIndexCache = 64;
+
+/**
+ * A single event in the history of a player, as recorded by the game index
+ * and returned by game_playerhistory.
+ */
+struct CGameEvent
+{
+    enum Type : uint8_t
+    {
+        SPAWN = 1,  //!< The player name was registered (name_firstupdate).
+        DEATH,      //!< The player was killed.
+        KILL,       //!< One of the player's characters killed someone.
+        BOUNTY,     //!< Collected loot was paid out to the player.
+        REFUND,     //!< Coins were refunded after death in the spawn area.
+    };
+
+    uint8_t type;
+    uint256 hashBlock;
+    int nHeight;
+    uint256 txid;
+
+    /** For DEATH and KILL, the KilledByInfo::Reason.  */
+    int reason;
+    /** For DEATH, the killing characters (if any).  For KILL, the victim.  */
+    std::vector<std::string> others;
+    /** The character involved for KILL, BOUNTY and REFUND.  */
+    int character;
+    /** The paid out amount for BOUNTY and REFUND.  */
+    CAmount amount;
+
+    CGameEvent()
+        : type(0), nHeight(-1), reason(0), character(-1), amount(0)
+    {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(type);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(txid);
+        READWRITE(reason);
+        READWRITE(others);
+        READWRITE(character);
+        READWRITE(amount);
+    }
+
+    /** Return the event type as string for the RPC interface.  */
+    std::string GetTypeString() const;
+};
+
+/** The events of a block, keyed by player name.  */
+typedef std::map<std::string, std::vector<CGameEvent>> GameEventMap;
+
+/**
+ * Extract all player events from a block and its game transactions.
+ * @param block The block itself.
+ * @param pindex The block's index entry.
+ * @param vGameTx The block's game transactions.
+ * @param events Put the events here, keyed by player name.
+ */
+void ExtractGameEvents(const CBlock& block, const CBlockIndex* pindex,
+                       const std::vector<CTransactionRef>& vGameTx,
+                       GameEventMap& events);
+
+/**
+ * GameIndex records the history of each player (spawns, deaths, kills and
+ * bounty payouts) keyed by player name and height.  This information is
+ * otherwise only available from the game transactions in the undo data.
+ */
+class GameIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex,
+                    const std::vector<CTransactionRef>& vGameTx) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "gameindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit GameIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~GameIndex() override;
+
+    /// Look up the history of a player in the main chain.  Events of a single
+    /// block are never split, so that more than count events may be returned.
+    ///
+    /// @param[in]   name  The player name.
+    /// @param[in]   from_height  Return only events starting at this height.
+    /// @param[in]   count  Stop after this many events.
+    /// @param[out]  events  The events found, in order.
+    /// @param[out]  next_height  Height to continue with for the next page,
+    ///                           or -1 if there are no more events.
+    /// @return  false on a database error
+    bool FindPlayerEvents(const std::string& name, int from_height, size_t count,
+                          std::vector<CGameEvent>& events, int& next_height) const;
+};
+
+/// The global game index.  May be null.
+extern std::unique_ptr<GameIndex> g_gameindex;
+
+#endif // BITCOIN_INDEX_GAMEINDEX_H
@@ -0,0 +1,124 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/statsindex.h>
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <game/db.h>
+#include <game/move.h>
+#include <game/state.h>
+#include <script/names.h>
+#include <util.h>
+#include <validation.h>
+#include <version.h>
+
+constexpr char DB_BLOCK_STATS = 's';
+
+std::unique_ptr<StatsIndex> g_statsindex;
+
+void ComputeBlockStats(const CBlock& block, const std::vector<CTransactionRef>& vGameTx,
+                       const GameState& state, CBlockStats& stats)
+{
+    stats = CBlockStats();
+    stats.hashBlock = block.GetHash();
+    stats.nTime = block.nTime;
+    stats.nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+
+    for (const auto& tx : block.vtx) {
+        bool isNameTx = false;
+        for (const auto& txout : tx->vout) {
+            const CNameScript op(txout.scriptPubKey);
+            if (op.isNameOp()) {
+                isNameTx = true;
+                break;
+            }
+        }
+
+        if (isNameTx)
+            ++stats.nNameTx;
+        else
+            ++stats.nCurrencyTx;
+    }
+    assert(stats.nNameTx + stats.nCurrencyTx == block.vtx.size());
+    stats.nGameTx = vGameTx.size();
+
+    stats.nPlayers = state.players.size();
+    for (const auto& cur : state.players)
+        stats.nHunters += cur.second.characters.size();
+}
+
+/** Access to the stats index database (indexes/stats/) */
+class StatsIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Read the statistics stored for the given height.
+    bool ReadStats(int height, CBlockStats& stats) const;
+
+    /// Write the statistics for the given height.
+    bool WriteStats(int height, const CBlockStats& stats);
+};
+
+StatsIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "stats", n_cache_size, f_memory, f_wipe)
+{}
+
+bool StatsIndex::DB::ReadStats(int height, CBlockStats& stats) const
+{
+    return Read(std::make_pair(DB_BLOCK_STATS, height), stats);
+}
+
+bool StatsIndex::DB::WriteStats(int height, const CBlockStats& stats)
+{
+    return Write(std::make_pair(DB_BLOCK_STATS, height), stats);
+}
+
+StatsIndex::StatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<StatsIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+StatsIndex::~StatsIndex() {}
+
+bool StatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex,
+                            const std::vector<CTransactionRef>& vGameTx)
+{
+    LOCK(cs_state);
+
+    const Consensus::Params& params = Params().GetConsensus();
+    std::unique_ptr<GameState> newState(new GameState(params));
+
+    /* When blocks are indexed in order, advance our own copy of the game
+       state.  Otherwise (at the start, or after a reorg), fetch the state
+       from the game DB.  */
+    if (pindex->pprev && m_game_state
+            && m_game_state->hashBlock == pindex->pprev->GetBlockHash()) {
+        CValidationState valid;
+        StepResult res;
+        if (!PerformStep(block, *m_game_state, nullptr, valid, res, *newState)) {
+            return error("%s: failed to perform game step", __func__);
+        }
+    } else if (!pgameDb->get(pindex->GetBlockHash(), *newState)) {
+        return error("%s: failed to read game state", __func__);
+    }
+    m_game_state = std::move(newState);
+
+    CBlockStats stats;
+    ComputeBlockStats(block, vGameTx, *m_game_state, stats);
+    return m_db->WriteStats(pindex->nHeight, stats);
+}
+
+BaseIndex::DB& StatsIndex::GetDB() const { return *m_db; }
+
+bool StatsIndex::LookupStats(const CBlockIndex* pindex, CBlockStats& stats) const
+{
+    /* Entries are keyed by height.  Make sure that the one we find is
+       actually for the requested block and not left over from a block
+       that has since been reorged out.  */
+    if (!m_db->ReadStats(pindex->nHeight, stats)) {
+        return false;
+    }
+    return stats.hashBlock == pindex->GetBlockHash();
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_STATSINDEX_H
+#define BITCOIN_INDEX_STATSINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <memory>
+
+struct GameState;
+
+/** Default for -statsindex.  */
+static const bool DEFAULT_STATSINDEX = false;
+/** Maximum database cache size for the stats index in MiB.  */
+static const int64_t nMaxStatsIndexCache = 64;
+
+/**
+ * Aggregated statistics about a single block and the game state after it,
+ * as returned by getstatsforheight.
+ */
+struct CBlockStats
+{
+    uint256 hashBlock;
+    int64_t nTime;
+    uint32_t nSize;
+
+    uint32_t nCurrencyTx;
+    uint32_t nNameTx;
+    uint32_t nGameTx;
+
+    uint32_t nPlayers;
+    uint32_t nHunters;
+
+    CBlockStats()
+        : nTime(0), nSize(0), nCurrencyTx(0), nNameTx(0), nGameTx(0),
+          nPlayers(0), nHunters(0)
+    {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nTime);
+        READWRITE(nSize);
+        READWRITE(nCurrencyTx);
+        READWRITE(nNameTx);
+        READWRITE(nGameTx);
+        READWRITE(nPlayers);
+        READWRITE(nHunters);
+    }
+};
+
+/**
+ * Compute the statistics for a block.
+ * @param block The block itself.
+ * @param vGameTx The block's game transactions.
+ * @param state The game state after the block.
+ * @param stats Put the result here.
+ */
+void ComputeBlockStats(const CBlock& block, const std::vector<CTransactionRef>& vGameTx,
+                       const GameState& state, CBlockStats& stats);
+
+/**
+ * StatsIndex keeps the statistics of each block in the main chain by height,
+ * so that they can be queried for many heights at once without reading
+ * blocks from disk or recomputing game states.
+ */
+class StatsIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// The game state after the last indexed block.  While syncing, the next
+    /// state is computed from it instead of being requested from the game DB,
+    /// which would have to replay blocks for old states.
+    CCriticalSection cs_state;
+    std::unique_ptr<GameState> m_game_state;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex,
+                    const std::vector<CTransactionRef>& vGameTx) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "statsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit StatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~StatsIndex() override;
+
+    /// Look up the statistics of a block.
+    ///
+    /// @param[in]   pindex  The block to look up.
+    /// @param[out]  stats  The block's statistics.
+    /// @return  true if the block is indexed, false otherwise
+    bool LookupStats(const CBlockIndex* pindex, CBlockStats& stats) const;
+};
+
+/// The global stats index.  May be null.
+extern std::unique_ptr<StatsIndex> g_statsindex;
+
+#endif // BITCOIN_INDEX_STATSINDEX_H
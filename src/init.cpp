@@ -20,8 +20,12 @@
 #include <game/db.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <index/gameindex.h>
+#include <index/statsindex.h>
 #include <index/txindex.h>
 #include <key.h>
+#include <names/index.h>
+#include <names/main.h>
 #include <validation.h>
 #include <miner.h>
 #include <netbase.h>
@@ -186,6 +190,12 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_statsindex) {
+        g_statsindex->Interrupt();
+    }
+    if (g_gameindex) {
+        g_gameindex->Interrupt();
+    }
 }
 
 void Shutdown()
@@ -219,6 +229,12 @@ void Shutdown()
     if (g_txindex) {
         g_txindex.reset();
     }
+    if (g_statsindex) {
+        g_statsindex.reset();
+    }
+    if (g_gameindex) {
+        g_gameindex.reset();
+    }
 
     StopTorControl();
 
@@ -267,6 +283,7 @@ void Shutdown()
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pgameDb.reset();
+        pnameIndex.reset();
         pblocktree.reset();
     }
     g_wallet_init_interface.Stop();
@@ -341,6 +358,7 @@ static void OnRPCStopped()
     RPCNotifyBlockChange(false, nullptr);
     g_best_block_cv.notify_all();
     cv_stateChange.notify_all();
+    WakeParkedHTTPRequests();
     LogPrint(BCLog::RPC, "RPC stopped.\n");
 }
 
@@ -367,6 +385,8 @@ void SetupServerArgs()
     gArgs.AddArg("-dbcache=<n>", strprintf("Set database cache size in megabytes (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-gamecache=<n>", strprintf("Keep the in-memory game state cache below <n> megabytes (minimum %d, default: %d)", MIN_GAME_CACHE, DEFAULT_GAME_CACHE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-gameindex", strprintf("Maintain an index of player spawns, deaths, kills and bounties, used by the game_playerhistory rpc call (default: %u)", DEFAULT_GAMEINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
@@ -384,11 +404,14 @@ void SetupServerArgs()
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-reindex-gamestate", "Rebuild the game state database from the currently indexed blocks.  If interrupted, this is resumed on the next start", false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", false, OptionsCategory::OPTIONS);
 #endif
+    gArgs.AddArg("-statsindex", strprintf("Maintain an index of per-block statistics, used by the getstatsforheight and getstatsforheightrange rpc calls (default: %u)", DEFAULT_STATSINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-namehistory", strprintf("Keep track of the full name history (default: %u)", 0), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-nameindex", strprintf("Maintain an in-memory index of all names to speed up name_filter and name_scan (default: %u)", DEFAULT_NAMEINDEX), false, OptionsCategory::OPTIONS);
 
     gArgs.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-banscore=<n>", strprintf("Threshold for disconnecting misbehaving peers (default: %u)", DEFAULT_BANSCORE_THRESHOLD), false, OptionsCategory::CONNECTION);
@@ -443,6 +466,8 @@ void SetupServerArgs()
     gArgs.AddArg("-checklevel=<n>", strprintf("How thorough the block verification of -checkblocks is (0-4, default: %u)", DEFAULT_CHECKLEVEL), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checknamechanges", strprintf("Check the consistency of the name database, UTXO set and game state for the names changed by each block (default: %u)", DEFAULT_CHECKNAMECHANGES), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checknamedb=<n>", "Do a full consistency check of the name database, UTXO set and game state every <n> blocks (0 = every block, -1 = never)", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", true, OptionsCategory::DEBUG_TEST);
@@ -491,6 +516,7 @@ void SetupServerArgs()
     gArgs.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", true, OptionsCategory::BLOCK_CREATION);
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcbatchthreads=<n>", strprintf("Set the number of threads to execute read-only calls of a JSON-RPC batch concurrently (default: %d)", DEFAULT_RPC_BATCH_THREADS), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcuser. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)", false, OptionsCategory::RPC);
@@ -574,9 +600,18 @@ static void BlockNotifyGenesisWait(bool, const CBlockIndex *pBlockIndex)
 
 static void WaitForChangeCallback(bool initialSync, const CBlockIndex *pBlockIndex)
 {
-    if (initialSync || !pBlockIndex)
+    if (!pBlockIndex)
+        return;
+    // Record the new tip for waiters.  Since they check it while holding
+    // mut_currentState, none can miss the notification below.
+    {
+        WaitableLock lock(mut_currentState);
+        hashCurrentState = pBlockIndex->GetBlockHash();
+    }
+    if (initialSync)
         return;
     cv_stateChange.notify_all();
+    WakeParkedHTTPRequests();
 }
 
 struct CImportingNow
@@ -940,6 +975,12 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-statsindex", DEFAULT_STATSINDEX))
+            return InitError(_("Prune mode is incompatible with -statsindex."));
+        if (gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX))
+            return InitError(_("Prune mode is incompatible with -gameindex."));
+        if (gArgs.GetBoolArg("-reindex-gamestate", false))
+            return InitError(_("Prune mode is incompatible with -reindex-gamestate."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1419,6 +1460,7 @@ bool AppInitMain()
 
     fReindex = gArgs.GetBoolArg("-reindex", false);
     bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
+    bool fReindexGameState = gArgs.GetBoolArg("-reindex-gamestate", false);
 
     // cache size calculations
     int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
@@ -1428,18 +1470,30 @@ bool AppInitMain()
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t nStatsIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-statsindex", DEFAULT_STATSINDEX) ? nMaxStatsIndexCache << 20 : 0);
+    nTotalCache -= nStatsIndexCache;
+    int64_t nGameIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX) ? nMaxGameIndexCache << 20 : 0);
+    nTotalCache -= nGameIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    const int64_t nGameCacheUsage = std::max(gArgs.GetArg("-gamecache", DEFAULT_GAME_CACHE), MIN_GAME_CACHE) << 20;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1fMiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (gArgs.GetBoolArg("-statsindex", DEFAULT_STATSINDEX)) {
+        LogPrintf("* Using %.1fMiB for block statistics index database\n", nStatsIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX)) {
+        LogPrintf("* Using %.1fMiB for game index database\n", nGameIndexCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for in-memory game states\n", nGameCacheUsage * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
@@ -1514,7 +1568,7 @@ bool AppInitMain()
 
                 pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
-                pgameDb.reset(new CGameDB(false, fReindex));
+                pgameDb.reset(new CGameDB(false, fReindex, nGameCacheUsage));
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
@@ -1540,6 +1594,21 @@ bool AppInitMain()
                         break;
                     }
                     assert(chainActive.Tip() != nullptr);
+
+                    // Rebuild the game states if requested, or resume an
+                    // interrupted -reindex-gamestate.
+                    if (fReindexGameState) {
+                        pgameDb->startReindex();
+                    }
+                    if (pgameDb->isReindexing()) {
+                        uiInterface.InitMessage(_("Reindexing game states..."));
+                        if (!pgameDb->reindex()) {
+                            if (!fRequestShutdown) {
+                                strLoadError = _("Error reindexing the game states");
+                            }
+                            break;
+                        }
+                    }
                 }
 
                 if (!fReset) {
@@ -1625,11 +1694,29 @@ bool AppInitMain()
 
     // ********************************************************* Step 8: start indexers
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-        auto txindex_db = MakeUnique<TxIndexDB>(nTxIndexCache, false, fReindex);
-        g_txindex = MakeUnique<TxIndex>(std::move(txindex_db));
+        g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
         g_txindex->Start();
     }
 
+    if (gArgs.GetBoolArg("-statsindex", DEFAULT_STATSINDEX)) {
+        g_statsindex = MakeUnique<StatsIndex>(nStatsIndexCache, false, fReindex);
+        g_statsindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX)) {
+        g_gameindex = MakeUnique<GameIndex>(nGameIndexCache, false, fReindex);
+        g_gameindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-nameindex", DEFAULT_NAMEINDEX)) {
+        uiInterface.InitMessage(_("Loading name index..."));
+        nStart = GetTimeMillis();
+        pnameIndex = MakeUnique<CNameIndex>();
+        LOCK(cs_main);
+        pnameIndex->build(*pcoinsTip, chainActive.Height());
+        LogPrintf("Loaded %u names into the name index: %15dms\n", pnameIndex->size(), GetTimeMillis() - nStart);
+    }
+
     // ********************************************************* Step 9: load wallet
     if (!g_wallet_init_interface.Open()) return false;
 
@@ -1663,6 +1750,11 @@ bool AppInitMain()
         uiInterface.NotifyBlockTip.connect(BlockNotifyCallback);
 
     /* Connect handler for game_waitforchange notifications.  */
+    {
+        WaitableLock lock(mut_currentState);
+        if (chainActive.Tip() != nullptr)
+            hashCurrentState = chainActive.Tip()->GetBlockHash();
+    }
     uiInterface.NotifyBlockTip.connect(WaitForChangeCallback);
 
     std::vector<fs::path> vImportFiles;
@@ -1672,6 +1764,13 @@ bool AppInitMain()
 
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
+    // Rebuild the recent game states in the background, so that the first
+    // blocks and RPC calls do not have to replay them while holding cs_main.
+    if (!fReindex) {
+        std::function<void()> warmUp = [] { pgameDb->warmUp(); };
+        threadGroup.create_thread(boost::bind(&TraceThread<std::function<void()>>, "gamewarmup", warmUp));
+    }
+
     // Wait for genesis block to be processed
     {
         WaitableLock lock(cs_GenesisWait);
@@ -12,6 +12,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -93,6 +94,18 @@ static inline size_t DynamicUsage(const prevector<N, X, S, D>& v)
     return MallocUsage(v.allocated_memory());
 }
 
+static inline size_t DynamicUsage(const std::string& s)
+{
+    // Short strings are stored inside the object itself by most standard
+    // library implementations.
+    const char* data = s.data();
+    const char* obj = reinterpret_cast<const char*>(&s);
+    if (data >= obj && data < obj + sizeof(s)) {
+        return 0;
+    }
+    return MallocUsage(s.capacity() + 1);
+}
+
 template<typename X, typename Y>
 static inline size_t DynamicUsage(const std::set<X, Y>& s)
 {
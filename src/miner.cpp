@@ -103,8 +103,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
 {
     int64_t nTimeStart = GetTimeMicros();
 
-    resetBlock();
-
     pblocktemplate.reset(new CBlockTemplate());
 
     if(!pblocktemplate.get())
@@ -121,11 +119,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     assert(pindexPrev != nullptr);
     nHeight = pindexPrev->nHeight + 1;
 
-    prevGameState.reset(new GameState(chainparams.GetConsensus()));
-    if (!pgameDb->get(*pindexPrev->phashBlock, *prevGameState))
-        throw std::runtime_error(strprintf("%s: Failed to read prev game state", __func__));
-    gameStep.reset(new StepData(*prevGameState));
-
     const int32_t nChainId = chainparams.GetConsensus ().nAuxpowChainId[algo];
     // FIXME: Active version bits after the always-auxpow fork!
     //const int32_t nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
@@ -137,33 +130,14 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     if (chainparams.MineBlocksOnDemand())
         pblock->SetBaseVersion(gArgs.GetArg("-blockversion", pblock->GetBaseVersion()), nChainId);
 
-    pblock->nTime = GetAdjustedTime();
-    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
-
-    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
-                       ? nMedianTimePast
-                       : pblock->GetBlockTime();
-
-    // Decide whether to include witness transactions
-    // This is only needed in case the witness softfork activation is reverted
-    // (which would require a very deep reorganization) or when
-    // -promiscuousmempoolflags is used.
-    // TODO: replace this with a call to main to assess validity of a mempool
-    // transaction (which in most cases can be a no-op).
-    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus()) && fMineWitnessTx;
-
+    // Select the transactions and compute miner taxes from the game step.
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
-
-    int64_t nTime1 = GetTimeMicros();
-
-    // Compute miner taxes from game step.
-    assert(gameStep->newHash.IsNull());
     GameState newGameState(chainparams.GetConsensus());
     StepResult stepResult;
-    if (!PerformStep(*prevGameState, *gameStep, newGameState, stepResult))
-        throw std::runtime_error(strprintf("%s: game engine failed to perform step", __func__));
+    addTxsAndStep(pindexPrev, fMineWitnessTx, newGameState, stepResult, nPackagesSelected, nDescendantsUpdated);
+
+    int64_t nTime1 = GetTimeMicros();
 
     nLastBlockTx = nBlockTx;
     nLastBlockWeight = nBlockWeight;
@@ -200,6 +174,55 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     return std::move(pblocktemplate);
 }
 
+void BlockAssembler::PreviewGameStep(uint256& hashPrev, GameState& newGameState, StepResult& stepResult, unsigned& nMoves)
+{
+    pblocktemplate.reset(new CBlockTemplate());
+    pblock = &pblocktemplate->block;
+
+    LOCK2(cs_main, mempool.cs);
+    const CBlockIndex* pindexPrev = chainActive.Tip();
+    assert(pindexPrev != nullptr);
+    hashPrev = pindexPrev->GetBlockHash();
+    nHeight = pindexPrev->nHeight + 1;
+
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+    addTxsAndStep(pindexPrev, true, newGameState, stepResult, nPackagesSelected, nDescendantsUpdated);
+    nMoves = gameStep->vMoves.size();
+}
+
+void BlockAssembler::addTxsAndStep(const CBlockIndex* pindexPrev, bool fMineWitnessTx, GameState& newGameState, StepResult& stepResult, int& nPackagesSelected, int& nDescendantsUpdated)
+{
+    resetBlock();
+
+    // The shared handle avoids copying the state while the locks are held.
+    prevGameState = pgameDb->getShared(pindexPrev->GetBlockHash());
+    if (!prevGameState)
+        throw std::runtime_error(strprintf("%s: Failed to read prev game state", __func__));
+    gameStep.reset(new StepData(*prevGameState));
+
+    pblock->nTime = GetAdjustedTime();
+    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
+
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                       ? nMedianTimePast
+                       : pblock->GetBlockTime();
+
+    // Decide whether to include witness transactions
+    // This is only needed in case the witness softfork activation is reverted
+    // (which would require a very deep reorganization) or when
+    // -promiscuousmempoolflags is used.
+    // TODO: replace this with a call to main to assess validity of a mempool
+    // transaction (which in most cases can be a no-op).
+    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus()) && fMineWitnessTx;
+
+    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+
+    assert(gameStep->newHash.IsNull());
+    if (!PerformStep(*prevGameState, *gameStep, newGameState, stepResult))
+        throw std::runtime_error(strprintf("%s: game engine failed to perform step", __func__));
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
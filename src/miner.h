@@ -148,7 +148,7 @@ private:
     const CChainParams& chainparams;
 
     // Game state context.
-    std::unique_ptr<GameState> prevGameState;
+    std::shared_ptr<const GameState> prevGameState;
     std::unique_ptr<StepData> gameStep;
 
 public:
@@ -164,10 +164,24 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(PowAlgo algo, const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
 
+    /**
+     * Select the mempool transactions like CreateNewBlock and perform the
+     * game step with their moves on the current tip's game state.  Only the
+     * parts of the step that do not depend on the new block's hash are done
+     * (like miners do it to compute the tax), so that this predicts the game
+     * state after the next block except for spawns and random events.
+     * hashPrev is set to the tip on which the preview builds.
+     */
+    void PreviewGameStep(uint256& hashPrev, GameState& newGameState, StepResult& stepResult, unsigned& nMoves);
+
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
     void resetBlock();
+    /** Select the mempool transactions for a block on top of pindexPrev
+      * and perform the game step with their moves.  The block template
+      * must already be set up. */
+    void addTxsAndStep(const CBlockIndex* pindexPrev, bool fMineWitnessTx, GameState& newGameState, StepResult& stepResult, int& nPackagesSelected, int& nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
 
@@ -8,6 +8,8 @@
 
 #include <univalue.h>
 
+#include <memory>
+
 bool fNameHistory = false;
 
 void
@@ -52,6 +54,9 @@ class CCacheNameIterator : public CNameIterator
 
 private:
 
+  /** Copy of the cache if this iterator is used on a snapshot.  */
+  std::unique_ptr<const CNameCache> ownedCache;
+
   /** Reference to cache object that is used.  */
   const CNameCache& cache;
 
@@ -82,6 +87,14 @@ public:
    */
   CCacheNameIterator (const CNameCache& c, CNameIterator* b);
 
+  /**
+   * Construct the iterator based on a private copy of the cache.  This takes
+   * ownership of both the cache copy and the base iterator.
+   * @param c The cache copy to use.
+   * @param b The base iterator.
+   */
+  CCacheNameIterator (std::unique_ptr<const CNameCache> c, CNameIterator* b);
+
   /* Destruct, this deletes also the base iterator.  */
   ~CCacheNameIterator ();
 
@@ -100,6 +113,13 @@ CCacheNameIterator::CCacheNameIterator (const CNameCache& c, CNameIterator* b)
   seek (valtype ());
 }
 
+CCacheNameIterator::CCacheNameIterator (std::unique_ptr<const CNameCache> c,
+                                        CNameIterator* b)
+  : ownedCache(std::move (c)), cache(*ownedCache), base(b)
+{
+  seek (valtype ());
+}
+
 CCacheNameIterator::~CCacheNameIterator ()
 {
   delete base;
@@ -220,29 +240,72 @@ CNameCache::iterateNames (CNameIterator* base) const
   return new CCacheNameIterator (*this, base);
 }
 
+CNameIterator*
+CNameCache::iterateNamesSnapshot (CNameIterator* base) const
+{
+  /* Only the name entries are needed for iteration, so we do not copy
+     the history changes.  */
+  std::unique_ptr<CNameCache> copy(new CNameCache ());
+  copy->entries = entries;
+  copy->deleted = deleted;
+
+  return new CCacheNameIterator (std::move (copy), base);
+}
+
 bool
-CNameCache::getHistory (const valtype& name, CNameHistory& res) const
+CNameCache::getHistorySize (const valtype& name, unsigned& size) const
 {
   assert (fNameHistory);
 
-  const std::map<valtype, CNameHistory>::const_iterator i = history.find (name);
+  const auto i = history.find (name);
   if (i == history.end ())
     return false;
 
-  res = i->second;
+  size = i->second.size;
+  return true;
+}
+
+bool
+CNameCache::getHistoryEntry (const valtype& name, const unsigned index,
+                             CNameData& data) const
+{
+  assert (fNameHistory);
+
+  const auto i = history.find (name);
+  if (i == history.end ())
+    return false;
+  assert (index < i->second.size);
+
+  const auto ei = i->second.entries.find (index);
+  if (ei == i->second.entries.end ())
+    return false;
+
+  data = ei->second;
   return true;
 }
 
 void
-CNameCache::setHistory (const valtype& name, const CNameHistory& data)
+CNameCache::pushHistory (const valtype& name, const unsigned size,
+                         const CNameData& data)
 {
   assert (fNameHistory);
 
-  const std::map<valtype, CNameHistory>::iterator ei = history.find (name);
-  if (ei != history.end ())
-    ei->second = data;
-  else
-    history.insert (std::make_pair (name, data));
+  HistoryChanges& changes = history[name];
+  changes.size = size + 1;
+  changes.entries[size] = data;
+  changes.erased.erase (size);
+}
+
+void
+CNameCache::popHistory (const valtype& name, const unsigned size)
+{
+  assert (fNameHistory);
+  assert (size > 0);
+
+  HistoryChanges& changes = history[name];
+  changes.size = size - 1;
+  changes.entries.erase (size - 1);
+  changes.erased.insert (size - 1);
 }
 
 void
@@ -256,7 +319,19 @@ CNameCache::apply (const CNameCache& cache)
        i != cache.deleted.end (); ++i)
     remove (*i);
 
-  for (std::map<valtype, CNameHistory>::const_iterator i
-        = cache.history.begin (); i != cache.history.end (); ++i)
-    setHistory (i->first, i->second);
+  for (const auto& entry : cache.history)
+    {
+      HistoryChanges& changes = history[entry.first];
+      changes.size = entry.second.size;
+      for (const unsigned index : entry.second.erased)
+        {
+          changes.entries.erase (index);
+          changes.erased.insert (index);
+        }
+      for (const auto& e : entry.second.entries)
+        {
+          changes.entries[e.first] = e.second;
+          changes.erased.erase (e.first);
+        }
+    }
 }
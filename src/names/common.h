@@ -185,7 +185,9 @@ public:
 
 /**
  * Keep track of a name's history.  This is a stack of old CNameData
- * objects that have been obsoleted.
+ * objects that have been obsoleted.  In the database, the entries are
+ * stored individually (see CCoinsView::GetNameHistoryEntry); this class
+ * is used when the full history of a name is needed at once.
  */
 class CNameHistory
 {
@@ -329,11 +331,28 @@ private:
   /** Deleted names.  */
   std::set<valtype> deleted;
 
+public:
+
   /**
-   * New or updated history stacks.  If they are empty, the corresponding
-   * database entry is deleted instead.
+   * Changes to the history stack of a single name.  The database stores
+   * each history entry individually keyed by the name and its index in
+   * the stack, so that pushing or popping an entry does not require
+   * to rewrite the full stack.
    */
-  std::map<valtype, CNameHistory> history;
+  struct HistoryChanges
+  {
+    /** The new size of the history stack.  */
+    unsigned size;
+    /** New entries by their index.  */
+    std::map<unsigned, CNameData> entries;
+    /** Indices of entries that have been popped.  */
+    std::set<unsigned> erased;
+  };
+
+private:
+
+  /** Changes to history stacks.  */
+  std::map<valtype, HistoryChanges> history;
 
   friend class CCacheNameIterator;
 
@@ -369,7 +388,21 @@ public:
   inline bool
   isDeleted (const valtype& name) const
   {
-    return (deleted.count (name) > 0); 
+    return (deleted.count (name) > 0);
+  }
+
+  /* Read-only access to the new or updated names.  */
+  inline const EntryMap&
+  getEntries () const
+  {
+    return entries;
+  }
+
+  /* Read-only access to the deleted names.  */
+  inline const std::set<valtype>&
+  getDeleted () const
+  {
+    return deleted;
   }
 
   /* Try to get a name's associated data.  This looks only
@@ -388,20 +421,46 @@ public:
      ownership of.  */
   CNameIterator* iterateNames (CNameIterator* base) const;
 
+  /* Return a name iterator like iterateNames, but based on a private copy
+     of the current cache content.  Later changes to this cache do not
+     affect the returned iterator.  The base iterator should be a snapshot
+     as well, and is taken ownership of.  */
+  CNameIterator* iterateNamesSnapshot (CNameIterator* base) const;
+
   /**
-   * Query for an history entry.
+   * Query for the size of a name's history stack.
    * @param name The name to look up.
-   * @param res Put the resulting history entry here.
-   * @return True iff the name was found in the cache.
+   * @param size Put the stack size here.
+   * @return True iff the name's history was changed in the cache.
    */
-  bool getHistory (const valtype& name, CNameHistory& res) const;
+  bool getHistorySize (const valtype& name, unsigned& size) const;
 
   /**
-   * Set a name history entry.
+   * Query for a single history entry.  The index must be smaller than the
+   * current stack size.  Entries that are not found in the cache are
+   * unchanged from the base view.
+   * @param name The name to look up.
+   * @param index The index in the history stack.
+   * @param data Put the entry here.
+   * @return True iff the entry was found in the cache.
+   */
+  bool getHistoryEntry (const valtype& name, unsigned index,
+                        CNameData& data) const;
+
+  /**
+   * Push a new entry onto a name's history stack.
    * @param name The name to modify.
+   * @param size The stack size before the push.
    * @param data The new history entry.
    */
-  void setHistory (const valtype& name, const CNameHistory& data);
+  void pushHistory (const valtype& name, unsigned size, const CNameData& data);
+
+  /**
+   * Pop the top entry of a name's history stack.
+   * @param name The name to modify.
+   * @param size The stack size before the pop.
+   */
+  void popHistory (const valtype& name, unsigned size);
 
   /* Apply all the changes in the passed-in record on top of this one.  */
   void apply (const CNameCache& cache);
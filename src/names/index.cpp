@@ -0,0 +1,415 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <names/index.h>
+
+#include <coins.h>
+
+#include <algorithm>
+#include <cctype>
+
+std::unique_ptr<CNameIndex> pnameIndex;
+
+namespace
+{
+
+/** Minimum length of a literal for which the trigram index is used.  */
+constexpr size_t TRIGRAM_LENGTH = 3;
+
+/**
+ * Pack the trigram starting at the given position into an integer.
+ */
+uint32_t
+GetTrigram (const valtype& str, size_t pos)
+{
+  assert (pos + TRIGRAM_LENGTH <= str.size ());
+  return (static_cast<uint32_t> (str[pos]) << 16)
+          | (static_cast<uint32_t> (str[pos + 1]) << 8)
+          | static_cast<uint32_t> (str[pos + 2]);
+}
+
+/**
+ * Check whether a valtype starts with the given prefix.
+ */
+bool
+HasPrefix (const valtype& str, const valtype& prefix)
+{
+  return str.size () >= prefix.size ()
+          && std::equal (prefix.begin (), prefix.end (), str.begin ());
+}
+
+} // anonymous namespace
+
+/* ************************************************************************** */
+
+void
+ExtractRegexLiterals (const std::string& pattern,
+                      std::string& prefix, std::string& literal)
+{
+  prefix.clear ();
+  literal.clear ();
+
+  /* Groups and alternatives can make any part of the pattern optional.
+     We do not try to analyse them at all.  */
+  if (pattern.find_first_of ("|()") != std::string::npos)
+    return;
+
+  size_t i = 0;
+  bool inPrefix = false;
+  if (!pattern.empty () && pattern[0] == '^')
+    {
+      inPrefix = true;
+      ++i;
+    }
+
+  std::string run;
+  const auto endRun = [&] ()
+    {
+      if (run.size () > literal.size ())
+        literal = run;
+      run.clear ();
+      inPrefix = false;
+    };
+
+  while (i < pattern.size ())
+    {
+      /* Parse the next atom.  */
+      bool isLiteral = false;
+      char atom = 0;
+      const char c = pattern[i];
+      if (c == '\\')
+        {
+          if (i + 1 >= pattern.size ())
+            break;
+          const char next = pattern[i + 1];
+          /* In xpressive, \< and \> are word boundary assertions like \b.
+             All other non-alphanumeric escapes are literals.  */
+          const bool wordAssertion = (next == '<' || next == '>');
+          if (!wordAssertion
+                && !std::isalnum (static_cast<unsigned char> (next)))
+            {
+              isLiteral = true;
+              atom = next;
+            }
+          else if (!wordAssertion
+                    && std::string ("dDwWsSbBnrtfv").find (next)
+                        == std::string::npos)
+            {
+              /* Escapes like \x41, \u0041, \cA or back-references continue
+                 after the escaped character.  Rather than parsing them, we
+                 give up on the whole pattern.  */
+              prefix.clear ();
+              literal.clear ();
+              return;
+            }
+          i += 2;
+        }
+      else if (c == '[')
+        {
+          /* Skip the character class.  A closing bracket right at the
+             beginning of the class is taken as literal.  */
+          ++i;
+          if (i < pattern.size () && pattern[i] == '^')
+            ++i;
+          if (i < pattern.size () && pattern[i] == ']')
+            ++i;
+          while (i < pattern.size () && pattern[i] != ']')
+            i += (pattern[i] == '\\' ? 2 : 1);
+          if (i >= pattern.size ())
+            {
+              /* Unterminated class, the pattern is invalid anyway.  */
+              prefix.clear ();
+              literal.clear ();
+              return;
+            }
+          ++i;
+        }
+      else if (std::string (".^$*+?{}").find (c) != std::string::npos)
+        ++i;
+      else
+        {
+          isLiteral = true;
+          atom = c;
+          ++i;
+        }
+
+      /* Handle a quantifier following the atom.  */
+      bool optional = false;
+      bool repeated = false;
+      if (i < pattern.size ())
+        switch (pattern[i])
+          {
+          case '*':
+          case '?':
+            optional = true;
+            ++i;
+            break;
+
+          case '{':
+            /* We do not care about the actual bounds, and conservatively
+               assume that the atom may be missing.  */
+            optional = true;
+            while (i < pattern.size () && pattern[i] != '}')
+              ++i;
+            ++i;
+            break;
+
+          case '+':
+            repeated = true;
+            ++i;
+            break;
+
+          default:
+            break;
+          }
+      if ((optional || repeated) && i < pattern.size ()
+            && (pattern[i] == '?' || pattern[i] == '+'))
+        ++i;
+
+      if (!isLiteral || optional)
+        {
+          endRun ();
+          continue;
+        }
+
+      run.push_back (atom);
+      if (inPrefix)
+        prefix.push_back (atom);
+      if (repeated)
+        endRun ();
+    }
+
+  endRun ();
+}
+
+/* ************************************************************************** */
+
+CNameIndex::CNameIndex ()
+  : nHeight(-1)
+{}
+
+void
+CNameIndex::insert (const valtype& name, const CNameData& data)
+{
+  AssertLockHeld (cs);
+
+  const auto mit = names.find (name);
+  if (mit != names.end ())
+    {
+      const auto bit = byHeight.find (mit->second.getHeight ());
+      assert (bit != byHeight.end ());
+      bit->second.erase (name);
+      if (bit->second.empty ())
+        byHeight.erase (bit);
+
+      mit->second = data;
+    }
+  else
+    {
+      names.insert (std::make_pair (name, data));
+      sortedNames.insert (name);
+      for (size_t i = 0; i + TRIGRAM_LENGTH <= name.size (); ++i)
+        trigrams[GetTrigram (name, i)].insert (name);
+    }
+
+  byHeight[data.getHeight ()].insert (name);
+}
+
+void
+CNameIndex::erase (const valtype& name)
+{
+  AssertLockHeld (cs);
+
+  const auto mit = names.find (name);
+  if (mit == names.end ())
+    return;
+
+  const auto bit = byHeight.find (mit->second.getHeight ());
+  assert (bit != byHeight.end ());
+  bit->second.erase (name);
+  if (bit->second.empty ())
+    byHeight.erase (bit);
+
+  for (size_t i = 0; i + TRIGRAM_LENGTH <= name.size (); ++i)
+    {
+      const auto tit = trigrams.find (GetTrigram (name, i));
+      assert (tit != trigrams.end ());
+      tit->second.erase (name);
+      if (tit->second.empty ())
+        trigrams.erase (tit);
+    }
+
+  sortedNames.erase (name);
+  names.erase (mit);
+}
+
+void
+CNameIndex::findSubstring (const valtype& literal,
+                           std::set<valtype>& out) const
+{
+  AssertLockHeld (cs);
+  assert (literal.size () >= TRIGRAM_LENGTH);
+
+  /* Find the smallest posting list of all trigrams in the literal.  If
+     one of them is missing, no name can match.  */
+  const std::set<valtype>* best = nullptr;
+  for (size_t i = 0; i + TRIGRAM_LENGTH <= literal.size (); ++i)
+    {
+      const auto tit = trigrams.find (GetTrigram (literal, i));
+      if (tit == trigrams.end ())
+        return;
+      if (best == nullptr || tit->second.size () < best->size ())
+        best = &tit->second;
+    }
+  assert (best != nullptr);
+
+  for (const auto& name : *best)
+    if (std::search (name.begin (), name.end (),
+                     literal.begin (), literal.end ()) != name.end ())
+      out.insert (name);
+}
+
+void
+CNameIndex::build (const CCoinsView& view, int height)
+{
+  LOCK (cs);
+
+  names.clear ();
+  sortedNames.clear ();
+  byHeight.clear ();
+  trigrams.clear ();
+
+  valtype name;
+  CNameData data;
+  std::unique_ptr<CNameIterator> iter(view.IterateNames ());
+  while (iter->next (name, data))
+    insert (name, data);
+
+  nHeight = height;
+}
+
+void
+CNameIndex::apply (const CNameCache& changes, const int height)
+{
+  LOCK (cs);
+
+  for (const auto& entry : changes.getEntries ())
+    insert (entry.first, entry.second);
+  for (const auto& name : changes.getDeleted ())
+    erase (name);
+
+  nHeight = height;
+}
+
+int
+CNameIndex::getHeight () const
+{
+  LOCK (cs);
+  return nHeight;
+}
+
+size_t
+CNameIndex::size () const
+{
+  LOCK (cs);
+  return names.size ();
+}
+
+int
+CNameIndex::scan (const valtype& start, unsigned count, EntryList& out) const
+{
+  LOCK (cs);
+
+  out.clear ();
+  for (auto mit = names.lower_bound (start);
+       mit != names.end () && count > 0; ++mit, --count)
+    out.push_back (*mit);
+
+  return nHeight;
+}
+
+int
+CNameIndex::findCandidates (const std::string* pattern, const int maxage,
+                            EntryList& out) const
+{
+  out.clear ();
+
+  std::string prefixStr, literalStr;
+  if (pattern != nullptr)
+    ExtractRegexLiterals (*pattern, prefixStr, literalStr);
+  const valtype prefix = ValtypeFromString (prefixStr);
+  const valtype literal = ValtypeFromString (literalStr);
+
+  LOCK (cs);
+
+  /* Names updated at this height or later are young enough.  */
+  const int minHeight = (maxage == 0 ? 0 : nHeight - maxage + 1);
+  const auto isRecent = [minHeight] (const CNameData& data)
+    {
+      return static_cast<int> (data.getHeight ()) >= minHeight;
+    };
+
+  /* Count the names in the height buckets that are recent enough, so that
+     we can decide which of the index structures gives fewer candidates.  */
+  size_t numRecent = names.size ();
+  std::map<unsigned, std::set<valtype>>::const_iterator recentBegin;
+  recentBegin = byHeight.begin ();
+  if (minHeight > 0)
+    {
+      recentBegin = byHeight.lower_bound (minHeight);
+      numRecent = 0;
+      for (auto bit = recentBegin; bit != byHeight.end (); ++bit)
+        numRecent += bit->second.size ();
+    }
+
+  /* Find candidates based on the regexp.  */
+  bool haveRegexpCandidates = false;
+  std::set<valtype> regexpCandidates;
+  if (!prefix.empty ())
+    {
+      for (auto it = sortedNames.lower_bound (prefix);
+           it != sortedNames.end () && HasPrefix (*it, prefix); ++it)
+        regexpCandidates.insert (*it);
+      haveRegexpCandidates = true;
+    }
+  if (literal.size () >= TRIGRAM_LENGTH
+        && (!haveRegexpCandidates || regexpCandidates.size () > numRecent))
+    {
+      regexpCandidates.clear ();
+      findSubstring (literal, regexpCandidates);
+      haveRegexpCandidates = true;
+    }
+
+  /* Collect the data in database order from the smaller candidate set,
+     and check the age criterion for each of them.  */
+  CNameCache::EntryMap result;
+  if (haveRegexpCandidates && regexpCandidates.size () <= numRecent)
+    {
+      for (const auto& name : regexpCandidates)
+        {
+          const auto mit = names.find (name);
+          assert (mit != names.end ());
+          if (isRecent (mit->second))
+            result.insert (*mit);
+        }
+    }
+  else if (minHeight > 0)
+    {
+      for (auto bit = recentBegin; bit != byHeight.end (); ++bit)
+        for (const auto& name : bit->second)
+          {
+            const auto mit = names.find (name);
+            assert (mit != names.end ());
+            result.insert (*mit);
+          }
+    }
+  else
+    {
+      out.assign (names.begin (), names.end ());
+      return nHeight;
+    }
+
+  out.assign (result.begin (), result.end ());
+  return nHeight;
+}
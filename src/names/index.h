@@ -0,0 +1,159 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef H_BITCOIN_NAMES_INDEX
+#define H_BITCOIN_NAMES_INDEX
+
+#include <names/common.h>
+#include <sync.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class CCoinsView;
+
+/** Default for -nameindex.  */
+static const bool DEFAULT_NAMEINDEX = false;
+
+/**
+ * In-memory secondary index over the name database.  It mirrors the names
+ * of the chain tip (pcoinsTip) and is kept up-to-date whenever blocks are
+ * connected or disconnected.  In addition to the name data itself, it keeps
+ * lookup structures (a lexicographically ordered name set for prefix
+ * queries, trigrams for substring queries and buckets by update height) that
+ * allow name_filter and name_scan to only look at candidate names.  All
+ * queries are done under the index's own lock, so that they do not need
+ * to hold cs_main.
+ */
+class CNameIndex
+{
+
+public:
+
+  /** Type for lists of names with their data, as returned by queries.  */
+  typedef std::vector<std::pair<valtype, CNameData>> EntryList;
+
+private:
+
+  /** Lock protecting all the index data.  */
+  mutable CCriticalSection cs;
+
+  /** All names with their data, in the same order as the database.  */
+  CNameCache::EntryMap names;
+
+  /** Names sorted lexicographically, so that prefixes are ranges.  */
+  std::set<valtype> sortedNames;
+
+  /** Names bucketed by their last update height.  */
+  std::map<unsigned, std::set<valtype>> byHeight;
+
+  /** Map trigrams (three bytes packed into an integer) to names.  */
+  std::unordered_map<uint32_t, std::set<valtype>> trigrams;
+
+  /** The block height the index corresponds to.  */
+  int nHeight;
+
+  /**
+   * Insert a new name or update the data of an existing one.
+   * @param name The name to update.
+   * @param data The name's new data.
+   */
+  void insert (const valtype& name, const CNameData& data);
+
+  /**
+   * Remove a name from the index.  It is fine if it does not exist.
+   * @param name The name to remove.
+   */
+  void erase (const valtype& name);
+
+  /**
+   * Find the names that contain a given literal substring.  The literal
+   * must be at least three bytes long.
+   * @param literal The substring to look for.
+   * @param out Put the matching names here.
+   */
+  void findSubstring (const valtype& literal, std::set<valtype>& out) const;
+
+public:
+
+  CNameIndex ();
+
+  CNameIndex (const CNameIndex&) = delete;
+  void operator= (const CNameIndex&) = delete;
+
+  /**
+   * Fill the index with all names from the given view.  This clears
+   * existing data first.
+   * @param view The coins view to read the names from.
+   * @param height The block height of the view.
+   */
+  void build (const CCoinsView& view, int height);
+
+  /**
+   * Apply the name changes of a connected or disconnected block.
+   * @param changes The name changes done to the chain tip.
+   * @param height The new block height of the tip.
+   */
+  void apply (const CNameCache& changes, int height);
+
+  /**
+   * Return the current height of the index.
+   * @return The block height the index is at.
+   */
+  int getHeight () const;
+
+  /**
+   * Return the number of names in the index.
+   * @return The number of names.
+   */
+  size_t size () const;
+
+  /**
+   * Scan names in the database order, like CNameIterator does.
+   * @param start Start at this name.
+   * @param count Return at most this many names.
+   * @param out Put the resulting names here.
+   * @return The block height the result corresponds to.
+   */
+  int scan (const valtype& start, unsigned count, EntryList& out) const;
+
+  /**
+   * Find all names that could match a filter query.  The result is
+   * returned in database order, and all names updated too long ago are
+   * excluded already.  The regular expression is not yet applied, though;
+   * it is only used to narrow down the candidates.
+   * @param pattern Regular expression (or null if none is used).
+   * @param maxage Only names updated in the last maxage blocks; 0 for all.
+   * @param out Put the candidates here.
+   * @return The block height the result corresponds to.
+   */
+  int findCandidates (const std::string* pattern, int maxage,
+                      EntryList& out) const;
+
+};
+
+/**
+ * Extract literal parts from a regular expression that any matching string
+ * must contain.  This is conservative:  If the pattern contains constructs
+ * that are not understood (e. g., groups, alternatives or escapes other
+ * than single-character classes), then no literals are returned.  The
+ * prefix is only valid if the pattern is compiled with
+ * regex_constants::single_line, so that ^ does not match after line breaks
+ * within names.
+ * @param pattern The regular expression.
+ * @param prefix Set to a string that all matches must start with.
+ * @param literal Set to the longest substring all matches must contain.
+ */
+void ExtractRegexLiterals (const std::string& pattern,
+                           std::string& prefix, std::string& literal);
+
+/** The global name index, if -nameindex is enabled.  */
+extern std::unique_ptr<CNameIndex> pnameIndex;
+
+#endif // H_BITCOIN_NAMES_INDEX
@@ -9,6 +9,9 @@
 #include <consensus/validation.h>
 #include <hash.h>
 #include <dbwrapper.h>
+#include <game/db.h>
+#include <game/state.h>
+#include <random.h>
 #include <script/interpreter.h>
 #include <script/names.h>
 #include <txmempool.h>
@@ -36,6 +39,20 @@ CNameTxUndo::apply (CCoinsViewCache& view) const
     view.SetName (name, oldData, true);
 }
 
+/* ************************************************************************** */
+/* SaltedNameHasher.  */
+
+SaltedNameHasher::SaltedNameHasher ()
+  : k0(GetRand (std::numeric_limits<uint64_t>::max ())),
+    k1(GetRand (std::numeric_limits<uint64_t>::max ()))
+{}
+
+size_t
+SaltedNameHasher::operator() (const valtype& name) const
+{
+  return CSipHasher (k0, k1).Write (name.data (), name.size ()).Finalize ();
+}
+
 /* ************************************************************************** */
 /* CNameMemPool.  */
 
@@ -110,11 +127,15 @@ CNameMemPool::remove (const CTxMemPoolEntry& entry)
     }
 }
 
-void
-CNameMemPool::removeConflicts (const CTransaction& tx)
+namespace
 {
-  AssertLockHeld (pool.cs);
 
+/**
+ * Add all names registered by the given transaction to the set.
+ */
+void
+AddRegisteredNames (const CTransaction& tx, std::set<valtype>& names)
+{
   if (!tx.IsNamecoin ())
     return;
 
@@ -122,20 +143,66 @@ CNameMemPool::removeConflicts (const CTransaction& tx)
     {
       const CNameScript nameOp(txout.scriptPubKey);
       if (nameOp.isNameOp () && nameOp.getNameOp () == OP_NAME_FIRSTUPDATE)
+        names.insert (nameOp.getOpName ());
+    }
+}
+
+} // anonymous namespace
+
+void
+CNameMemPool::removeConflicts (const CTransaction& tx)
+{
+  AssertLockHeld (pool.cs);
+
+  std::set<valtype> registered;
+  AddRegisteredNames (tx, registered);
+
+  for (const auto& name : registered)
+    {
+      const NameTxMap::const_iterator mit = mapNameRegs.find (name);
+      if (mit != mapNameRegs.end ())
         {
-          const valtype& name = nameOp.getOpName ();
-          const NameTxMap::const_iterator mit = mapNameRegs.find (name);
-          if (mit != mapNameRegs.end ())
-            {
-              const CTxMemPool::txiter mit2 = pool.mapTx.find (mit->second);
-              assert (mit2 != pool.mapTx.end ());
-              pool.removeRecursive (mit2->GetTx (),
-                                    MemPoolRemovalReason::NAME_CONFLICT);
-            }
+          const CTxMemPool::txiter mit2 = pool.mapTx.find (mit->second);
+          assert (mit2 != pool.mapTx.end ());
+          pool.removeRecursive (mit2->GetTx (),
+                                MemPoolRemovalReason::NAME_CONFLICT);
         }
     }
 }
 
+void
+CNameMemPool::removeConflicts (const std::vector<CTransactionRef>& vtx)
+{
+  AssertLockHeld (pool.cs);
+
+  if (mapNameRegs.empty ())
+    return;
+
+  std::set<valtype> registered;
+  for (const auto& tx : vtx)
+    AddRegisteredNames (*tx, registered);
+
+  /* Look up all conflicting transactions first, since removing them
+     modifies mapNameRegs.  */
+  std::vector<uint256> conflicts;
+  for (const auto& name : registered)
+    {
+      const NameTxMap::const_iterator mit = mapNameRegs.find (name);
+      if (mit != mapNameRegs.end ())
+        conflicts.push_back (mit->second);
+    }
+
+  for (const auto& txid : conflicts)
+    {
+      /* The transaction may have been removed already as descendant of
+         another conflict.  */
+      const CTxMemPool::txiter mit = pool.mapTx.find (txid);
+      if (mit != pool.mapTx.end ())
+        pool.removeRecursive (mit->GetTx (),
+                              MemPoolRemovalReason::NAME_CONFLICT);
+    }
+}
+
 void
 CNameMemPool::removeReviveConflicts (const std::set<valtype>& revived)
 {
@@ -246,7 +313,7 @@ CNameMemPool::checkTx (const CTransaction& tx) const
         case OP_NAME_NEW:
           {
             const valtype& newHash = nameOp.getOpHash ();
-            std::map<valtype, uint256>::const_iterator mi;
+            NameTxMap::const_iterator mi;
             mi = mapNameNews.find (newHash);
             if (mi != mapNameNews.end () && mi->second != tx.GetHash ())
               return false;
@@ -263,8 +330,13 @@ CNameMemPool::checkTx (const CTransaction& tx) const
 
         case OP_NAME_UPDATE:
           {
+            /* A pending update may be superseded by a new move that spends
+               the same name output.  Whether the replacement is actually
+               allowed (fee rules) is decided by the caller, which removes
+               the old tx before the new one is added.  */
             const valtype& name = nameOp.getOpName ();
-            if (updatesName (name))
+            if (updatesName (name)
+                  && !spendsSameInput (tx, getTxForName (name)))
               return false;
             break;
           }
@@ -277,6 +349,110 @@ CNameMemPool::checkTx (const CTransaction& tx) const
   return true;
 }
 
+bool
+CNameMemPool::spendsSameInput (const CTransaction& tx,
+                               const uint256& txid) const
+{
+  AssertLockHeld (pool.cs);
+
+  for (const auto& txin : tx.vin)
+    {
+      const auto mit = pool.mapNextTx.find (txin.prevout);
+      if (mit != pool.mapNextTx.end () && mit->second->GetHash () == txid)
+        return true;
+    }
+
+  return false;
+}
+
+bool
+CNameMemPool::getConfirmedName (const valtype& name, const CCoinsView& tip,
+                                CNameData& data) const
+{
+  AssertLockHeld (pool.cs);
+
+  const uint256 tipHash = tip.GetBestBlock ();
+  if (tipHash != confirmedNamesTip)
+    {
+      confirmedNames.clear ();
+      confirmedNamesTip = tipHash;
+    }
+
+  const auto mit = confirmedNames.find (name);
+  if (mit != confirmedNames.end ())
+    {
+      data = mit->second;
+      return true;
+    }
+
+  if (!tip.GetName (name, data))
+    return false;
+
+  confirmedNames.emplace (name, data);
+  return true;
+}
+
+bool
+CNameMemPool::checkUpdateFast (const CTransaction& tx,
+                               const CCoinsView& tip) const
+{
+  AssertLockHeld (pool.cs);
+
+  if (!tx.IsNamecoin ())
+    return true;
+
+  for (const auto& txout : tx.vout)
+    {
+      const CNameScript nameOp(txout.scriptPubKey);
+      if (!nameOp.isNameOp () || nameOp.getNameOp () != OP_NAME_UPDATE)
+        continue;
+
+      /* Updates can not be chained in the mempool (see checkTx), so that
+         a valid update always spends the confirmed name output.  */
+      CNameData data;
+      if (!getConfirmedName (nameOp.getOpName (), tip, data) || data.isDead ())
+        return false;
+
+      const COutPoint& current = data.getUpdateOutpoint ();
+      bool found = false;
+      for (const auto& txin : tx.vin)
+        if (txin.prevout == current)
+          {
+            found = true;
+            break;
+          }
+      if (!found)
+        return false;
+    }
+
+  return true;
+}
+
+bool
+IsNameUpdateReplacement (const CTransaction& tx, const CTransaction& replaced)
+{
+  if (!tx.IsNamecoin () || !replaced.IsNamecoin ())
+    return false;
+
+  std::set<valtype> updated;
+  for (const auto& txout : replaced.vout)
+    {
+      const CNameScript nameOp(txout.scriptPubKey);
+      if (nameOp.isNameOp () && nameOp.getNameOp () == OP_NAME_UPDATE)
+        updated.insert (nameOp.getOpName ());
+    }
+
+  for (const auto& txout : tx.vout)
+    {
+      const CNameScript nameOp(txout.scriptPubKey);
+      if (nameOp.isNameOp () && nameOp.getNameOp () == OP_NAME_UPDATE
+            && updated.count (nameOp.getOpName ()) > 0)
+        return true;
+    }
+
+  return false;
+}
+
 /* ************************************************************************** */
 /* CNameConflictTracker.  */
 
@@ -604,3 +780,79 @@ CheckNameDB (bool disconnect)
       assert (false);
     }
 }
+
+bool
+ValidateNameChanges (const CCoinsViewCache& view, const GameState& newState,
+                     const PlayerSet& changedPlayers)
+{
+  const CNameCache& changes = view.GetNameCache ();
+  std::set<valtype> touched = changes.getDeleted ();
+  for (const auto& entry : changes.getEntries ())
+    touched.insert (entry.first);
+
+  /* Players can only be added, removed or have their locked coins changed
+     together with a change to their name.  */
+  for (const auto& id : changedPlayers)
+    if (touched.count (ValtypeFromString (id)) == 0)
+      return error ("%s : player %s changed without a name change",
+                    __func__, id.c_str ());
+
+  /* For all changed names, verify that the name database, the UTXO set
+     and the game state agree.  */
+  for (const auto& name : touched)
+    {
+      const std::string nameStr = ValtypeToString (name);
+      const auto mi = newState.players.find (nameStr);
+
+      CNameData data;
+      if (!view.GetName (name, data) || data.isDead ())
+        {
+          if (mi != newState.players.end ())
+            return error ("%s : name '%s' is in the game but not alive",
+                          __func__, nameStr.c_str ());
+          continue;
+        }
+
+      Coin coin;
+      if (!view.GetCoin (data.getUpdateOutpoint (), coin))
+        return error ("%s : name '%s' in DB but not UTXO set",
+                      __func__, nameStr.c_str ());
+      const CNameScript nameOp(coin.out.scriptPubKey);
+      if (!nameOp.isNameOp () || !nameOp.isAnyUpdate ()
+            || nameOp.getOpName () != name)
+        return error ("%s : name '%s' points to a wrong output",
+                      __func__, nameStr.c_str ());
+
+      if (mi == newState.players.end ())
+        return error ("%s : name '%s' is alive but not in the game",
+                      __func__, nameStr.c_str ());
+      if (mi->second.lockedCoins != coin.out.nValue)
+        return error ("%s : locked coins of '%s' do not match the UTXO set",
+                      __func__, nameStr.c_str ());
+    }
+
+  return true;
+}
+
+void
+CheckNameChanges (const CCoinsViewCache& view, const uint256& newBlock,
+                  const PlayerSet& changedPlayers)
+{
+  if (!gArgs.GetBoolArg ("-checknamechanges", DEFAULT_CHECKNAMECHANGES))
+    return;
+
+  /* The state is normally cached, since it has just been computed or is
+     the previous tip.  The shared handle avoids copying it.  */
+  const auto newState = pgameDb->getShared (newBlock);
+  if (newState == nullptr)
+    {
+      LogPrintf ("ERROR: %s : failed to read game state\n", __func__);
+      assert (false);
+    }
+
+  if (!ValidateNameChanges (view, *newState, changedPlayers))
+    {
+      LogPrintf ("ERROR: %s : name database is inconsistent\n", __func__);
+      assert (false);
+    }
+}
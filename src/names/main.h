@@ -6,6 +6,7 @@
 #define H_BITCOIN_NAMES_MAIN
 
 #include <amount.h>
+#include <game/common.h>
 #include <names/common.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
@@ -16,6 +17,8 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class CBlockUndo;
 class CCoinsView;
@@ -23,6 +26,7 @@ class CCoinsViewCache;
 class CTxMemPool;
 class CTxMemPoolEntry;
 class CValidationState;
+struct GameState;
 
 /* Some constants defining name limits.  */
 static const unsigned MAX_VALUE_LENGTH = 4095;
@@ -32,6 +36,9 @@ static const unsigned MIN_FIRSTUPDATE_DEPTH = 2;
 /** Amount to lock (at least for minimum) in name_new.  */
 static const CAmount NAMENEW_COIN_AMOUNT = COIN / 5;
 
+/** Default for -checknamechanges.  */
+static const bool DEFAULT_CHECKNAMECHANGES = false;
+
 /* ************************************************************************** */
 /* CNameTxUndo.  */
 
@@ -83,6 +90,29 @@ public:
 
 };
 
+/* ************************************************************************** */
+/* SaltedNameHasher.  */
+
+/**
+ * Salted hasher for names, so that they can be used as keys in hashed
+ * containers without letting peers choose colliding names.
+ */
+class SaltedNameHasher
+{
+
+private:
+
+  /** Salt.  */
+  const uint64_t k0, k1;
+
+public:
+
+  SaltedNameHasher ();
+
+  size_t operator() (const valtype& name) const;
+
+};
+
 /* ************************************************************************** */
 /* CNameMemPool.  */
 
@@ -101,8 +131,13 @@ private:
   /** The parent mempool object.  Used to, e. g., remove conflicting tx.  */
   CTxMemPool& pool;
 
-  /** Type used for internal indices.  */
-  typedef std::map<valtype, uint256> NameTxMap;
+  /**
+   * Type used for internal indices.  They are only used for lookups and
+   * never iterated in order, so we use hashed containers.  Game moves are
+   * name updates, and thousands of them may be accepted right after each
+   * new block.
+   */
+  typedef std::unordered_map<valtype, uint256, SaltedNameHasher> NameTxMap;
 
   /**
    * Keep track of names that are registered by transactions in the pool.
@@ -120,6 +155,18 @@ private:
    */
   NameTxMap mapNameNews;
 
+  /**
+   * Cache of the confirmed data of names that have been looked up when
+   * accepting name updates.  Active players send a move in almost every
+   * block, so that this saves repeated lookups through the coins view.
+   * The cache belongs to the chain tip confirmedNamesTip, and is cleared
+   * whenever the tip changes.
+   */
+  mutable std::unordered_map<valtype, CNameData, SaltedNameHasher>
+      confirmedNames;
+  /** The best block that confirmedNames corresponds to.  */
+  mutable uint256 confirmedNamesTip;
+
 public:
 
   /**
@@ -127,7 +174,8 @@ public:
    * @param p The parent pool.
    */
   explicit inline CNameMemPool (CTxMemPool& p)
-    : pool(p), mapNameRegs(), mapNameUpdates(), mapNameNews()
+    : pool(p), mapNameRegs(), mapNameUpdates(), mapNameNews(),
+      confirmedNames(), confirmedNamesTip()
   {}
 
   /**
@@ -171,6 +219,8 @@ public:
     mapNameRegs.clear ();
     mapNameUpdates.clear ();
     mapNameNews.clear ();
+    confirmedNames.clear ();
+    confirmedNamesTip.SetNull ();
   }
 
   /**
@@ -196,6 +246,14 @@ public:
    */
   void removeConflicts (const CTransaction& tx);
 
+  /**
+   * Remove name conflicts for all transactions of a connected block.  This
+   * collects the names registered in the block first and then removes the
+   * conflicting mempool registrations in a single pass.
+   * @param vtx The block's transactions.
+   */
+  void removeConflicts (const std::vector<CTransactionRef>& vtx);
+
   /**
    * Remove conflicts in the mempool due to revived players.  This removes
    * conflicting name registrations that are no longer possible.
@@ -218,6 +276,38 @@ public:
    */
   bool checkTx (const CTransaction& tx) const;
 
+  /**
+   * Check whether a transaction spends one of the inputs also spent by
+   * the given mempool transaction.  This is the case for a move that
+   * supersedes a pending one.
+   * @param tx The new transaction.
+   * @param txid The mempool transaction's hash.
+   * @return True iff both spend a common input.
+   */
+  bool spendsSameInput (const CTransaction& tx, const uint256& txid) const;
+
+  /**
+   * Look up the confirmed data of a name, using the cache if possible.
+   * @param name The name to look up.
+   * @param tip The coins view of the current chain tip.
+   * @param data Put the name's data here.
+   * @return True iff the name exists.
+   */
+  bool getConfirmedName (const valtype& name, const CCoinsView& tip,
+                         CNameData& data) const;
+
+  /**
+   * Quickly check name updates against the cached confirmed name data,
+   * before the full validation is done.  This rejects updates of names
+   * that do not exist or are dead, and updates that do not spend the
+   * name's current output.  Such moves are common right after a new block,
+   * when players re-send moves built on a stale state.
+   * @param tx The transaction to check.
+   * @param tip The coins view of the current chain tip.
+   * @return False if the transaction is certainly invalid.
+   */
+  bool checkUpdateFast (const CTransaction& tx, const CCoinsView& tip) const;
+
 };
 
 /* ************************************************************************** */
@@ -277,6 +367,17 @@ bool CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
 void ApplyNameTransaction (const CTransaction& tx, unsigned nHeight,
                            CCoinsViewCache& view, CBlockUndo& undo);
 
+/**
+ * Check whether a transaction updates a name that is also updated by
+ * another one.  Such a pending move may be replaced in the mempool
+ * by a new move of the same player even if it does not signal BIP125.
+ * @param tx The new transaction.
+ * @param replaced The pending transaction it conflicts with.
+ * @return True iff both update a common name.
+ */
+bool IsNameUpdateReplacement (const CTransaction& tx,
+                              const CTransaction& replaced);
+
 /**
  * Check the name database consistency.  This calls CCoinsView::ValidateNameDB,
  * but only if applicable depending on the -checknamedb setting.  If it fails,
@@ -285,4 +386,37 @@ void ApplyNameTransaction (const CTransaction& tx, unsigned nHeight,
  */
 void CheckNameDB (bool disconnect);
 
+/**
+ * Check the consistency of the changes done by a single block, which is
+ * cheap enough to do for every block:  Only the names changed in the view
+ * and the players changed by the game step are looked at.  The players
+ * changed by the step must have a changed name, and for all changed names,
+ * the name database, the UTXO set and the game state must agree.
+ *
+ * The game step only adds, removes or changes the locked coins of players
+ * with moves (which have a name operation in the block anyway) and of
+ * killed players.  Hence the killed players are what the caller should
+ * pass as the changed players when connecting a block.
+ *
+ * @param view The view with the block's changes on top of the old tip.
+ * @param newState The game state after the block.
+ * @param changedPlayers Players whose existence or locked coins the
+ *                       game step changed.
+ * @return True iff the changes are consistent.
+ */
+bool ValidateNameChanges (const CCoinsViewCache& view,
+                          const GameState& newState,
+                          const PlayerSet& changedPlayers);
+
+/**
+ * Run ValidateNameChanges for a block that has just been connected to
+ * or disconnected from the tip, if -checknamechanges is set.  Fails with
+ * an assertion if the check fails.
+ * @param view The view with the block's changes on top of the old tip.
+ * @param newBlock The new tip's block hash.
+ * @param changedPlayers Players changed by the game step.
+ */
+void CheckNameChanges (const CCoinsViewCache& view, const uint256& newBlock,
+                       const PlayerSet& changedPlayers);
+
 #endif // H_BITCOIN_NAMES_MAIN
@@ -6,6 +6,8 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <game/db.h>
+#include <game/state.h>
 #include <index/txindex.h>
 #include <names/common.h>
 #include <primitives/block.h>
@@ -13,6 +15,7 @@
 #include <validation.h>
 #include <httpserver.h>
 #include <rpc/blockchain.h>
+#include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
@@ -24,6 +27,9 @@
 
 #include <univalue.h>
 
+#include <memory>
+#include <mutex>
+
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
 
 enum class RetFormat {
@@ -69,6 +75,23 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string me
     return false;
 }
 
+/** Reply with a potentially large JSON value, serialising it straight into
+ * the request's output buffer.
+ */
+static bool WriteJSONReply(HTTPRequest* req, const UniValue& val)
+{
+    JSONStreamWriter writer([req](const char* data, size_t len) {
+        req->AppendReplyBody(data, len);
+    });
+    writer.Write(val);
+    writer.WriteRaw("\n");
+    writer.Flush();
+
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK);
+    return true;
+}
+
 static RetFormat ParseDataFormat(std::string& param, const std::string& strReq)
 {
     const std::string::size_type pos = strReq.rfind('.');
@@ -299,10 +322,7 @@ static bool rest_block(HTTPRequest* req,
             LOCK(cs_main);
             objBlock = blockToJSON(block, vGameTx, pblockindex, showTxDetails);
         }
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return WriteJSONReply(req, objBlock);
     }
 
     default: {
@@ -379,11 +399,7 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
     switch (rf) {
     case RetFormat::JSON: {
         UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return WriteJSONReply(req, mempoolObject);
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
@@ -683,6 +699,130 @@ static bool rest_name(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Look up the game state for a block hash given in the URI.  */
+static std::shared_ptr<const GameState> GetGameStateForREST(HTTPRequest* req, const std::string& hashStr)
+{
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash)) {
+        RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+        return nullptr;
+    }
+
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0) {
+            RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            return nullptr;
+        }
+    }
+
+    auto state = pgameDb->getShared(hash);
+    if (!state)
+        RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to fetch game state");
+    return state;
+}
+
+/** Serialisation of the game state last requested in binary or hex form.  Clients
+ *  typically request the current tip repeatedly.  */
+static std::mutex cs_gameStateData;
+static uint256 gameStateDataHash;
+static std::shared_ptr<const std::string> gameStateData;
+
+static std::shared_ptr<const std::string> GetSerializedGameState(const GameState& state)
+{
+    std::lock_guard<std::mutex> lock(cs_gameStateData);
+    if (!gameStateData || gameStateDataHash != state.hashBlock) {
+        CDataStream ssState(SER_NETWORK, PROTOCOL_VERSION);
+        ssState << state;
+        gameStateData = std::make_shared<const std::string>(ssState.str());
+        gameStateDataHash = state.hashBlock;
+    }
+    return gameStateData;
+}
+
+/** Write a serialised object in the requested binary format.  */
+static bool WriteBinaryReply(HTTPRequest* req, RetFormat rf, const std::string& data)
+{
+    if (rf == RetFormat::BINARY) {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, data);
+    } else {
+        assert(rf == RetFormat::HEX);
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(data.begin(), data.end()) + "\n");
+    }
+    return true;
+}
+
+static bool rest_game_state(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    const auto state = GetGameStateForREST(req, hashStr);
+    if (!state)
+        return false;
+
+    switch (rf) {
+    case RetFormat::BINARY:
+    case RetFormat::HEX:
+        return WriteBinaryReply(req, rf, *GetSerializedGameState(*state));
+
+    case RetFormat::JSON:
+        return WriteJSONReply(req, state->ToJsonValue());
+
+    default:
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+}
+
+static bool rest_game_player(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    const std::string::size_type pos = param.find('/');
+    if (pos == std::string::npos)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Expected <hash>/<name>, got: " + param);
+    const std::string encodedName = param.substr(pos + 1);
+
+    valtype plainName;
+    if (!DecodeName(plainName, encodedName))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid encoded name: " + encodedName);
+    const PlayerID name = ValtypeToString(plainName);
+
+    const auto state = GetGameStateForREST(req, param.substr(0, pos));
+    if (!state)
+        return false;
+    const auto mi = state->players.find(name);
+    if (mi == state->players.end())
+        return RESTERR(req, HTTP_NOT_FOUND, "'" + name + "' not found");
+
+    switch (rf) {
+    case RetFormat::BINARY:
+    case RetFormat::HEX: {
+        CDataStream ssPlayer(SER_NETWORK, PROTOCOL_VERSION);
+        ssPlayer << mi->second;
+        return WriteBinaryReply(req, rf, ssPlayer.str());
+    }
+
+    case RetFormat::JSON: {
+        const int crownIndex = (name == state->crownHolder.player ? state->crownHolder.index : -1);
+        const std::string strJSON = mi->second.ToJsonValue(crownIndex).write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default:
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -696,6 +836,8 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/name/", rest_name},
+      {"/rest/game/state/", rest_game_state},
+      {"/rest/game/player/", rest_game_player},
 };
 
 bool StartREST()
@@ -128,6 +128,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblockstats", 0, "hash_or_height" },
     { "getblockstats", 1, "stats" },
     { "getstatsforheight", 0, "height" },
+    { "getstatsforheightrange", 0, "from" },
+    { "getstatsforheightrange", 1, "count" },
     { "pruneblockchain", 0, "height" },
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
@@ -147,6 +149,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "disconnectnode", 1, "nodeid" },
     { "addwitnessaddress", 1, "p2sh" },
     { "createauxblock", 1, "algo" },
+    { "name_history", 1, "from" },
+    { "name_history", 2, "count" },
     { "name_scan", 1, "count" },
     { "name_filter", 1, "maxage" },
     { "name_filter", 2, "from" },
@@ -160,8 +164,15 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "namerawtransaction", 2, "nameop" },
     { "sendtoname", 1, "amount" },
     { "sendtoname", 4, "subtractfeefromamount" },
+    { "game_getplayerstates", 0, "names" },
+    { "game_getregion", 0, "corner1" },
+    { "game_getregion", 1, "corner2" },
     { "game_getpath", 0, "from" },
     { "game_getpath", 1, "to" },
+    { "game_previewstep", 0, "diff" },
+    { "game_waitforchange", 1, "diff" },
+    { "game_playerhistory", 1, "fromheight" },
+    { "game_playerhistory", 2, "count" },
     // Echo with conversion (For testing only)
     { "echojson", 0, "arg0" },
     { "echojson", 1, "arg1" },
@@ -14,19 +14,82 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <chainparams.h>
+#include <core_io.h>
 #include <game/common.h>
 #include <game/db.h>
+#include <game/map.h>
 #include <game/movecreator.h>
+#include <game/region.h>
 #include <game/state.h>
 #include <game/tx.h>
+#include <fs.h>
+#include <index/gameindex.h>
+#include <miner.h>
 #include <rpc/server.h>
 #include <script/script.h>
 #include <sync.h>
+#include <txmempool.h>
 #include <uint256.h>
+#include <util.h>
 #include <validation.h>
 
 #include <univalue.h>
 
+#include <memory>
+#include <mutex>
+
+/**
+ * Return the block hash given as optional RPC parameter, or the current
+ * tip if it is null.  Throws if the block is not known.
+ */
+static uint256
+GetGameBlockHash (const UniValue& param)
+{
+  LOCK (cs_main);
+
+  uint256 hash;
+  if (!param.isNull ())
+    hash = uint256S (param.get_str ());
+  else
+    hash = *chainActive.Tip ()->phashBlock;
+
+  if (mapBlockIndex.count (hash) == 0)
+    throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+  return hash;
+}
+
+/**
+ * Look up the game state for the given block, without copying it.
+ */
+static std::shared_ptr<const GameState>
+GetGameState (const uint256& hash)
+{
+  auto state = pgameDb->getShared (hash);
+  if (!state)
+    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
+
+  return state;
+}
+
+/**
+ * Return the player state as JSON, including the crown if the player holds
+ * it.  Returns null if there is no such player.
+ */
+static UniValue
+PlayerToJson (const GameState& state, const PlayerID& name)
+{
+  const PlayerStateMap::const_iterator mi = state.players.find (name);
+  if (mi == state.players.end ())
+    return NullUniValue;
+
+  int crownIndex = -1;
+  if (name == state.crownHolder.player)
+    crownIndex = state.crownHolder.index;
+
+  return mi->second.ToJsonValue (crownIndex);
+}
+
 UniValue
 game_getplayerstate (const JSONRPCRequest& request)
 {
@@ -46,32 +109,50 @@ game_getplayerstate (const JSONRPCRequest& request)
         + HelpExampleRpc ("game_getplayerstate", "\"domob\" \"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\"")
       );
 
-  uint256 hash;
-  {
-    LOCK (cs_main);
-    if (request.params.size () >= 2)
-      hash = uint256S (request.params[1].get_str ());
-    else
-      hash = *chainActive.Tip ()->phashBlock;
+  const uint256 hash = GetGameBlockHash (request.params[1]);
+  const auto state = GetGameState (hash);
 
-    if (mapBlockIndex.count (hash) == 0)
-      throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-  }
+  const UniValue res = PlayerToJson (*state, request.params[0].get_str ());
+  if (res.isNull ())
+    throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "No such player");
 
-  GameState state(Params ().GetConsensus ());
-  if (!pgameDb->get (hash, state))
-    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
+  return res;
+}
 
-  const PlayerID name = request.params[0].get_str ();
-  PlayerStateMap::const_iterator mi = state.players.find (name);
-  if (mi == state.players.end ())
-    throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "No such player");
+UniValue
+game_getplayerstates (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () < 1 || request.params.size () > 2)
+    throw std::runtime_error (
+        "game_getplayerstates [\"name\",...] (\"hash\")\n"
+        "\nLook up and return the player states for multiple players at"
+        " either the latest block or the block with the given hash.\n"
+        "\nArguments:\n"
+        "1. \"names\"        (string array, mandatory) the player names\n"
+        "2. \"blockhash\"    (string, optional) the block hash\n"
+        "\nResult:\n"
+        "{\n"
+        "  \"name\": xxx,     (json object) the player state as returned by"
+        " game_getplayerstate, or null if there is no such player\n"
+        "  ...\n"
+        "}\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("game_getplayerstates", "\"[\\\"domob\\\",\\\"snailbrain\\\"]\"")
+        + HelpExampleRpc ("game_getplayerstates", "[\"domob\",\"snailbrain\"]")
+      );
 
-  int crownIndex = -1;
-  if (name == state.crownHolder.player)
-    crownIndex = state.crownHolder.index;
+  RPCTypeCheckArgument (request.params[0], UniValue::VARR);
+  const uint256 hash = GetGameBlockHash (request.params[1]);
+  const auto state = GetGameState (hash);
 
-  return mi->second.ToJsonValue (crownIndex);
+  UniValue res(UniValue::VOBJ);
+  for (const auto& name : request.params[0].getValues ())
+    {
+      const PlayerID id = name.get_str ();
+      res.pushKV (id, PlayerToJson (*state, id));
+    }
+
+  return res;
 }
 
 UniValue
@@ -92,74 +173,693 @@ game_getstate (const JSONRPCRequest& request)
         + HelpExampleRpc ("game_getstate", "\"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\"")
       );
 
-  uint256 hash;
+  const uint256 hash = GetGameBlockHash (request.params[0]);
+  return GetGameState (hash)->ToJsonValue ();
+}
+
+namespace
+{
+
+/* Spatial index for the game state last queried by game_getregion.  Map
+   viewers typically query the current tip repeatedly.  */
+std::mutex mutRegionGrid;
+std::shared_ptr<const CharacterGrid> regionGrid;
+
+std::shared_ptr<const CharacterGrid>
+GetCharacterGrid (const std::shared_ptr<const GameState>& state)
+{
+  std::lock_guard<std::mutex> lock(mutRegionGrid);
+  if (!regionGrid || regionGrid->GetState ().hashBlock != state->hashBlock)
+    regionGrid = std::make_shared<const CharacterGrid> (state);
+
+  return regionGrid;
+}
+
+Coord
+CoordFromJson (const UniValue& val)
+{
+  if (!val.isArray () || val.size () != 2)
+    throw JSONRPCError (RPC_INVALID_PARAMETER, "invalid coordinate given");
+
+  return Coord (val[0].get_int (), val[1].get_int ());
+}
+
+} // anonymous namespace
+
+UniValue
+game_getregion (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () < 2 || request.params.size () > 3)
+    throw std::runtime_error (
+        "game_getregion [x1,y1] [x2,y2] (\"hash\")\n"
+        "\nReturn the characters, loot, hearts and banks within a rectangular"
+        " region of the map (including the given corners) at either the"
+        " latest block or the block with the given hash.\n"
+        "\nArguments:\n"
+        "1. \"corner1\"      (int array, required) one corner of the region\n"
+        "2. \"corner2\"      (int array, required) the opposite corner\n"
+        "3. \"blockhash\"    (string, optional) the block hash\n"
+        "\nResult:\n"
+        "{\n"
+        "  \"characters\": [ (json array) characters in the region, with"
+        " their \"player\", \"index\" and \"color\"\n"
+        "    ...\n"
+        "  ],\n"
+        "  \"loot\": [ ... ],      (json array) loot in the region\n"
+        "  \"hearts\": [ ... ],    (json array) hearts in the region\n"
+        "  \"banks\": [ ... ],     (json array) banks in the region\n"
+        "  \"crown\": { ... },     (json object, optional) the crown if it"
+        " is in the region\n"
+        "  \"height\": n,          (numeric) the game state height\n"
+        "  \"hashBlock\": \"hash\" (string) the game state block hash\n"
+        "}\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("game_getregion", "[0,0] [100,100]")
+        + HelpExampleRpc ("game_getregion", "[0,0], [100,100]")
+      );
+
+  /* Clip the region to the map, so that arbitrary corners do not make us
+     iterate over huge ranges.  If it is completely off the map, the
+     result is empty.  */
+  MapRegion region(CoordFromJson (request.params[0]),
+                   CoordFromJson (request.params[1]));
+  const bool onMap = region.ClipToMap ();
+  const uint256 hash = GetGameBlockHash (request.params[2]);
+  const auto grid = GetCharacterGrid (GetGameState (hash));
+  const GameState& state = grid->GetState ();
+
+  std::vector<CharacterGrid::Entry> characters;
+  if (onMap)
+    grid->Query (region, characters);
+  UniValue jsonCharacters(UniValue::VARR);
+  for (const auto& c : characters)
+    {
+      const bool crown = (c.first == state.crownHolder);
+      UniValue obj = c.second->ToJsonValue (crown);
+      obj.pushKV ("player", c.first.player);
+      obj.pushKV ("index", c.first.index);
+      const auto mi = state.players.find (c.first.player);
+      assert (mi != state.players.end ());
+      obj.pushKV ("color", static_cast<int> (mi->second.color));
+      jsonCharacters.push_back (obj);
+    }
+
+  UniValue jsonLoot(UniValue::VARR);
+  ForEachInRegion (state.loot, region,
+    [&jsonLoot] (const std::pair<const Coord, LootInfo>& l)
+      {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV ("x", l.first.x);
+        obj.pushKV ("y", l.first.y);
+        obj.pushKV ("amount", ValueFromAmount (l.second.nAmount));
+        UniValue blkRng(UniValue::VARR);
+        blkRng.push_back (l.second.firstBlock);
+        blkRng.push_back (l.second.lastBlock);
+        obj.pushKV ("blockRange", blkRng);
+        jsonLoot.push_back (obj);
+      });
+
+  UniValue jsonHearts(UniValue::VARR);
+  ForEachInRegion (state.hearts, region,
+    [&jsonHearts] (const Coord& c)
+      {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV ("x", c.x);
+        obj.pushKV ("y", c.y);
+        jsonHearts.push_back (obj);
+      });
+
+  UniValue jsonBanks(UniValue::VARR);
+  ForEachInRegion (state.banks, region,
+    [&jsonBanks] (const std::pair<const Coord, unsigned>& b)
+      {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV ("x", b.first.x);
+        obj.pushKV ("y", b.first.y);
+        obj.pushKV ("life", static_cast<int> (b.second));
+        jsonBanks.push_back (obj);
+      });
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("characters", jsonCharacters);
+  res.pushKV ("loot", jsonLoot);
+  res.pushKV ("hearts", jsonHearts);
+  res.pushKV ("banks", jsonBanks);
+  if (onMap && region.Contains (state.crownPos))
+    {
+      UniValue crown(UniValue::VOBJ);
+      crown.pushKV ("x", state.crownPos.x);
+      crown.pushKV ("y", state.crownPos.y);
+      if (!state.crownHolder.player.empty ())
+        {
+          crown.pushKV ("holderName", state.crownHolder.player);
+          crown.pushKV ("holderIndex", state.crownHolder.index);
+        }
+      res.pushKV ("crown", crown);
+    }
+  res.pushKV ("height", state.nHeight);
+  res.pushKV ("hashBlock", state.hashBlock.GetHex ());
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+namespace
+{
+
+/**
+ * Compute the difference between two game states in their JSON form.  Players
+ * that are new or changed are included with their full state, removed players
+ * as null.  The other entries of the state are included if they changed.
+ */
+UniValue
+GameStateJsonDiff (const UniValue& from, const UniValue& to)
+{
+  const UniValue& oldPlayers = find_value (from, "players");
+  const UniValue& newPlayers = find_value (to, "players");
+
+  UniValue players(UniValue::VOBJ);
+  for (const auto& name : newPlayers.getKeys ())
+    {
+      const UniValue& val = find_value (newPlayers, name);
+      const UniValue& old = find_value (oldPlayers, name);
+      if (old.isNull () || old.write () != val.write ())
+        players.pushKV (name, val);
+    }
+  for (const auto& name : oldPlayers.getKeys ())
+    if (!newPlayers.exists (name))
+      players.pushKV (name, NullUniValue);
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("players", players);
+  for (const auto& key : to.getKeys ())
+    {
+      if (key == "players")
+        continue;
+      const UniValue& val = find_value (to, key);
+      if (find_value (from, key).write () != val.write ())
+        res.pushKV (key, val);
+    }
+
+  return res;
+}
+
+/**
+ * The last preview computed by game_previewstep.  It is reused for all
+ * requests until either the tip or the mempool changes.
+ */
+struct StepPreview
+{
+  uint256 hashPrev;
+  unsigned mempoolUpdated;
+
+  UniValue state;
+  UniValue diff;
+  unsigned nMoves;
+  CAmount nTaxAmount;
+};
+
+std::mutex mutStepPreview;
+std::shared_ptr<const StepPreview> stepPreview;
+
+std::shared_ptr<const StepPreview>
+GetStepPreview ()
+{
+  /* The lock is held while computing a new preview, so that concurrent
+     requests wait for it instead of doing the same work.  */
+  std::lock_guard<std::mutex> lock(mutStepPreview);
+
+  /* The mempool counter is read before selecting the transactions.  If the
+     mempool changes while computing, the next request recomputes.  */
+  const unsigned mempoolUpdated = mempool.GetTransactionsUpdated ();
+  uint256 tip;
   {
     LOCK (cs_main);
-    if (request.params.size () >= 1)
-      hash = uint256S (request.params[0].get_str ());
-    else
-      hash = *chainActive.Tip ()->phashBlock;
-
-    if (mapBlockIndex.count (hash) == 0)
-      throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    tip = chainActive.Tip ()->GetBlockHash ();
   }
+  if (stepPreview && stepPreview->hashPrev == tip
+        && stepPreview->mempoolUpdated == mempoolUpdated)
+    return stepPreview;
+
+  auto preview = std::make_shared<StepPreview> ();
+  preview->mempoolUpdated = mempoolUpdated;
+
+  GameState newState(Params ().GetConsensus ());
+  StepResult stepResult;
+  BlockAssembler (Params ()).PreviewGameStep (preview->hashPrev, newState,
+                                              stepResult, preview->nMoves);
+  preview->nTaxAmount = stepResult.nTaxAmount;
+
+  preview->state = newState.ToJsonValue ();
+  preview->diff
+    = GameStateJsonDiff (GetGameState (preview->hashPrev)->ToJsonValue (),
+                         preview->state);
+
+  stepPreview = preview;
+  return stepPreview;
+}
 
-  GameState state(Params ().GetConsensus ());
-  if (!pgameDb->get (hash, state))
-    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
+} // anonymous namespace
+
+UniValue
+game_previewstep (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () > 1)
+    throw std::runtime_error (
+        "game_previewstep (diff)\n"
+        "\nPredict the game state after the next block by applying the"
+        " moves that are pending in the mempool to the current state.  The"
+        " moves are selected as a miner would do it.  Parts of the step that"
+        " depend on the new block's hash (spawning, disasters, life-steal"
+        " distribution and new loot) are not included.\n"
+        "\nArguments:\n"
+        "1. diff             (boolean, optional, default=false) return only"
+        " the difference to the current state\n"
+        "\nResult:\n"
+        "{\n"
+        "  \"hashPrev\": \"hash\", (string) the block the preview builds on\n"
+        "  \"moves\": n,         (numeric) number of moves applied\n"
+        "  \"tax\": x.xxx,       (numeric) the miner tax of the step\n"
+        "  \"state\": { ... },   (json object) the predicted game state,"
+        " if diff is false\n"
+        "  \"diff\": {           (json object) the changes, if diff is true\n"
+        "    \"players\": { ... }, (json object) new or changed players,"
+        " and removed ones as null\n"
+        "    ...                 other changed entries of the game state\n"
+        "  }\n"
+        "}\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("game_previewstep", "")
+        + HelpExampleCli ("game_previewstep", "true")
+        + HelpExampleRpc ("game_previewstep", "true")
+      );
+
+  const bool diff = (!request.params[0].isNull ()
+                      && request.params[0].get_bool ());
+  const auto preview = GetStepPreview ();
 
-  return state.ToJsonValue ();
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("hashPrev", preview->hashPrev.GetHex ());
+  res.pushKV ("moves", static_cast<int> (preview->nMoves));
+  res.pushKV ("tax", ValueFromAmount (preview->nTaxAmount));
+  if (diff)
+    res.pushKV ("diff", preview->diff);
+  else
+    res.pushKV ("state", preview->state);
+
+  return res;
 }
 
 /* ************************************************************************** */
 
 UniValue
-game_waitforchange (const JSONRPCRequest& request)
+dumpgamestate (const JSONRPCRequest& request)
 {
-  if (request.fHelp || request.params.size () > 1)
+  if (request.fHelp || request.params.size () < 1 || request.params.size () > 2)
     throw std::runtime_error (
-        "game_waitforchange (\"hash\")\n"
-        "\nDo not use this call in new applications.  Instead, -blocknotify\n"
-        "or the ZeroMQ system should be used.\n"
+        "dumpgamestate \"path\" (\"blockhash\")\n"
+        "\nWrite a snapshot of the game state at the current tip or the"
+        " given block to a file.  It can be imported with loadgamestate.\n"
+        "\nArguments:\n"
+        "1. \"path\"         (string, required) the file to write, relative"
+        " to the data directory if not absolute\n"
+        "2. \"blockhash\"    (string, optional) the block hash\n"
+        "\nResult:\n"
+        "{\n"
+        "  \"blockhash\": xxx,  (string) the block of the game state\n"
+        "  \"height\": n,       (numeric) the height of the game state\n"
+        "  \"hash\": xxx,       (string) hash commitment of the game state\n"
+        "  \"path\": xxx        (string) the absolute path of the snapshot\n"
+        "}\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("dumpgamestate", "\"gamestate.dat\"")
+        + HelpExampleRpc ("dumpgamestate", "\"gamestate.dat\"")
       );
 
-  uint256 hash;
+  const fs::path path = fs::absolute (request.params[0].get_str (),
+                                      GetDataDir ());
+  if (fs::exists (path))
+    throw JSONRPCError (RPC_INVALID_PARAMETER,
+                        path.string () + " already exists");
+
+  const uint256 hash = GetGameBlockHash (request.params[1]);
+  const auto pstate = GetGameState (hash);
+  const GameState& state = *pstate;
+
+  uint256 commitment;
+  if (!WriteGameStateSnapshot (path, state, commitment))
+    throw JSONRPCError (RPC_MISC_ERROR, "Failed to write snapshot");
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("blockhash", state.hashBlock.GetHex ());
+  res.pushKV ("height", state.nHeight);
+  res.pushKV ("hash", commitment.GetHex ());
+  res.pushKV ("path", path.string ());
+
+  return res;
+}
+
+UniValue
+loadgamestate (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () < 1 || request.params.size () > 2)
+    throw std::runtime_error (
+        "loadgamestate \"path\" (\"hash\")\n"
+        "\nImport a game state snapshot written by dumpgamestate.  States"
+        " of later blocks are then computed from it instead of replaying"
+        " the game from the genesis block.\n"
+        "The snapshot is trusted, so the expected hash commitment should"
+        " be obtained from a trusted source and passed in.\n"
+        "\nArguments:\n"
+        "1. \"path\"         (string, required) the snapshot file, relative"
+        " to the data directory if not absolute\n"
+        "2. \"hash\"         (string, optional) the expected hash commitment\n"
+        "\nResult:\n"
+        "{\n"
+        "  \"blockhash\": xxx,  (string) the block of the game state\n"
+        "  \"height\": n,       (numeric) the height of the game state\n"
+        "  \"hash\": xxx        (string) hash commitment of the game state\n"
+        "}\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("loadgamestate", "\"gamestate.dat\"")
+        + HelpExampleRpc ("loadgamestate", "\"gamestate.dat\"")
+      );
+
+  const fs::path path = fs::absolute (request.params[0].get_str (),
+                                      GetDataDir ());
+
+  GameState state(Params ().GetConsensus ());
+  uint256 commitment;
+  std::string err;
+  if (!ReadGameStateSnapshot (path, state, commitment, err))
+    throw JSONRPCError (RPC_DESERIALIZATION_ERROR, err);
+
+  if (request.params.size () >= 2
+        && uint256S (request.params[1].get_str ()) != commitment)
+    throw JSONRPCError (RPC_VERIFY_ERROR,
+                        "Snapshot does not match the expected hash");
+
   {
     LOCK (cs_main);
-    if (request.params.size () >= 1)
-      hash = uint256S (request.params[0].get_str ());
-    else
-      hash = *chainActive.Tip ()->phashBlock;
-
-    if (mapBlockIndex.count (hash) == 0)
-      throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    const CBlockIndex* pindex = LookupBlockIndex (state.hashBlock);
+    if (pindex == nullptr)
+      throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY,
+                          "Block of the snapshot not found");
+    if (pindex->nHeight != state.nHeight)
+      throw JSONRPCError (RPC_VERIFY_ERROR,
+                          "Snapshot height does not match its block");
   }
 
-  WaitableLock lock(mut_currentState);
-  while (IsRPCRunning())
+  if (!pgameDb->importState (state))
+    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to import game state");
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("blockhash", state.hashBlock.GetHex ());
+  res.pushKV ("height", state.nHeight);
+  res.pushKV ("hash", commitment.GetHex ());
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+namespace
+{
+
+UniValue
+GameEventToJSON (const CGameEvent& ev)
+{
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("type", ev.GetTypeString ());
+  res.pushKV ("height", ev.nHeight);
+  res.pushKV ("blockhash", ev.hashBlock.GetHex ());
+  res.pushKV ("txid", ev.txid.GetHex ());
+
+  switch (ev.type)
     {
-      /* Atomically check whether we have found a new best block and return
-         it if that's the case.  We use a lock on cs_main in order to
-         prevent race conditions.  */
+    case CGameEvent::DEATH:
       {
-        LOCK (cs_main);
-        const uint256 bestHash = *chainActive.Tip ()->phashBlock;
-        if (hash != bestHash)
+        switch (ev.reason)
           {
-            GameState state(Params ().GetConsensus ());
-            if (!pgameDb->get (bestHash, state))
-              throw JSONRPCError (RPC_DATABASE_ERROR,
-                                  "Failed to fetch game state");
-
-            return state.ToJsonValue ();
+          case KilledByInfo::KILLED_DESTRUCT:
+            res.pushKV ("reason", "destruct");
+            break;
+          case KilledByInfo::KILLED_SPAWN:
+            res.pushKV ("reason", "spawn");
+            break;
+          case KilledByInfo::KILLED_POISON:
+            res.pushKV ("reason", "poison");
+            break;
           }
+
+        UniValue killers(UniValue::VARR);
+        for (const auto& k : ev.others)
+          killers.push_back (k);
+        res.pushKV ("killers", killers);
+        break;
       }
 
-      /* Wait on the condition variable.  */
-      cv_stateChange.wait (lock);
+    case CGameEvent::KILL:
+      res.pushKV ("character", ev.character);
+      if (!ev.others.empty ())
+        res.pushKV ("victim", ev.others.front ());
+      break;
+
+    case CGameEvent::BOUNTY:
+    case CGameEvent::REFUND:
+      res.pushKV ("character", ev.character);
+      res.pushKV ("amount", ValueFromAmount (ev.amount));
+      break;
+
+    default:
+      break;
     }
 
-  return UniValue();
+  return res;
+}
+
+} // anonymous namespace
+
+UniValue
+game_playerhistory (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () < 1 || request.params.size () > 3)
+    throw std::runtime_error (
+        "game_playerhistory \"name\" (fromheight count)\n"
+        "\nReturn the spawns, deaths, kills and bounty payouts of a player"
+        " in the main chain.  This requires -gameindex.\n"
+        "\nArguments:\n"
+        "1. \"name\"         (string, required) the player name\n"
+        "2. fromheight     (numeric, optional, default=0) the first height to"
+        " return events for\n"
+        "3. count          (numeric, optional, default=100) number of events to"
+        " return; events of the last block are always returned completely\n"
+        "\nResult:\n"
+        "{\n"
+        "  \"events\": [           (array) the events in chain order\n"
+        "    {\n"
+        "      \"type\": xxx,       (string) spawn, death, kill, bounty or refund\n"
+        "      \"height\": n,       (numeric) the block height\n"
+        "      \"blockhash\": xxx,  (string) the block hash\n"
+        "      \"txid\": xxx,       (string) the (game) transaction\n"
+        "      \"reason\": xxx,     (string) for deaths: destruct, spawn or poison\n"
+        "      \"killers\": [...],  (array) for deaths: the killing characters\n"
+        "      \"victim\": xxx,     (string) for kills: the killed player\n"
+        "      \"character\": n,    (numeric) for kills and payouts: the character index\n"
+        "      \"amount\": x.xxx,   (numeric) for payouts: the amount paid\n"
+        "    },\n"
+        "    ...\n"
+        "  ],\n"
+        "  \"next\": n           (numeric) fromheight for the next page,"
+        " or null if there are no more events\n"
+        "}\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("game_playerhistory", "\"domob\"")
+        + HelpExampleCli ("game_playerhistory", "\"domob\" 100000 50")
+        + HelpExampleRpc ("game_playerhistory", "\"domob\", 100000, 50")
+      );
+
+  if (!g_gameindex)
+    throw JSONRPCError (RPC_MISC_ERROR, "the game index is not enabled");
+
+  const std::string name = request.params[0].get_str ();
+  int fromHeight = 0;
+  if (request.params.size () >= 2 && !request.params[1].isNull ())
+    fromHeight = request.params[1].get_int ();
+  int count = 100;
+  if (request.params.size () >= 3 && !request.params[2].isNull ())
+    count = request.params[2].get_int ();
+  if (fromHeight < 0)
+    throw JSONRPCError (RPC_INVALID_PARAMETER, "Block height out of range");
+  if (count <= 0)
+    throw JSONRPCError (RPC_INVALID_PARAMETER, "count must be positive");
+
+  if (!g_gameindex->BlockUntilSyncedToCurrentChain ())
+    throw JSONRPCError (RPC_MISC_ERROR, "the game index is still syncing");
+
+  std::vector<CGameEvent> events;
+  int nextHeight;
+  if (!g_gameindex->FindPlayerEvents (name, fromHeight, count,
+                                      events, nextHeight))
+    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to read game index");
+
+  UniValue arr(UniValue::VARR);
+  for (const auto& ev : events)
+    arr.push_back (GameEventToJSON (ev));
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("events", arr);
+  if (nextHeight >= 0)
+    res.pushKV ("next", nextHeight);
+  else
+    res.pushKV ("next", NullUniValue);
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+namespace
+{
+
+/**
+ * The game state of a new tip, as returned to game_waitforchange.  It is
+ * converted to JSON only once per block and shared by all waiting clients.
+ * Diffs to the states that clients have seen before are cached as well,
+ * since typically all clients were waiting on the same previous block.
+ */
+class StateUpdate
+{
+
+private:
+
+  /** Maximum number of cached diffs.  */
+  static const size_t MAX_DIFFS = 16;
+
+  mutable std::mutex mutDiffs;
+  mutable std::map<uint256, UniValue> diffs;
+
+public:
+
+  const uint256 hash;
+  const UniValue state;
+
+  StateUpdate (const uint256& h, const UniValue& s)
+    : hash(h), state(s)
+  {}
+
+  StateUpdate (const StateUpdate&) = delete;
+  void operator= (const StateUpdate&) = delete;
+
+  /**
+   * Return the difference to the state of the given block.  The lock is
+   * held while computing it, so that it is done only once.
+   */
+  UniValue
+  GetDiff (const uint256& since) const
+  {
+    std::lock_guard<std::mutex> lock(mutDiffs);
+
+    const auto mit = diffs.find (since);
+    if (mit != diffs.end ())
+      return mit->second;
+
+    if (diffs.size () >= MAX_DIFFS)
+      diffs.clear ();
+
+    const UniValue diff
+      = GameStateJsonDiff (GetGameState (since)->ToJsonValue (), state);
+    diffs.emplace (since, diff);
+
+    return diff;
+  }
+
+};
+
+std::mutex mutStateUpdate;
+std::shared_ptr<const StateUpdate> stateUpdate;
+
+std::shared_ptr<const StateUpdate>
+GetStateUpdate (const uint256& hash)
+{
+  std::lock_guard<std::mutex> lock(mutStateUpdate);
+  if (!stateUpdate || stateUpdate->hash != hash)
+    stateUpdate = std::make_shared<const StateUpdate> (
+        hash, GetGameState (hash)->ToJsonValue ());
+
+  return stateUpdate;
+}
+
+} // anonymous namespace
+
+UniValue
+game_waitforchange (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () > 2)
+    throw std::runtime_error (
+        "game_waitforchange (\"hash\") (diff)\n"
+        "\nWait until the best block is different from \"hash\" and return"
+        " the game state of the new best block.  If no hash is given, wait"
+        " for the next block.\n"
+        "\nThe state is serialised only once per block for all waiting"
+        " clients.  Clients that already know the state at \"hash\" can"
+        " request only the changes since then, and pass the returned"
+        " \"hashBlock\" as \"hash\" to the next call.\n"
+        "\nArguments:\n"
+        "1. \"hash\"         (string, optional) the last known block hash\n"
+        "2. diff           (boolean, optional, default=false) return only"
+        " the difference to the state at \"hash\" in the format of"
+        " game_previewstep\n"
+        "\nResult:\n"
+        "JSON representation of the game state or its changes\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("game_waitforchange", "")
+        + HelpExampleCli ("game_waitforchange", "\"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\" true")
+        + HelpExampleRpc ("game_waitforchange", "\"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\", true")
+      );
+
+  const uint256 hash = GetGameBlockHash (request.params[0]);
+  const bool diff = (!request.params[1].isNull ()
+                      && request.params[1].get_bool ());
+
+  std::shared_ptr<const StateUpdate> update;
+  {
+    WaitableLock lock(mut_currentState);
+    while (IsRPCRunning ())
+      {
+        /* The tip is checked while holding mut_currentState, which is
+           also held when recording a new block.  Thus we can not miss
+           a notification between the check and the wait.  cs_main must not
+           be locked here, since notifications are sent with it held.  */
+        if (!hashCurrentState.IsNull () && hash != hashCurrentState)
+          {
+            const uint256 bestHash = hashCurrentState;
+            lock.unlock ();
+            update = GetStateUpdate (bestHash);
+            break;
+          }
+
+        /* Over HTTP, the request is parked until the next block instead of
+           blocking a worker thread.  It must then wait for a change from
+           the block we have now, even if no hash was given.  */
+        if (request.fParkable)
+          {
+            UniValue params(UniValue::VARR);
+            params.push_back (hash.GetHex ());
+            params.push_back (UniValue (diff));
+            throw RPCParkRequest (params);
+          }
+
+        cv_stateChange.wait (lock);
+      }
+  }
+
+  if (!update)
+    return UniValue ();
+  if (diff)
+    return update->GetDiff (hash);
+  return update->state;
 }
 
 /* ************************************************************************** */
@@ -219,12 +919,18 @@ game_getpath (const JSONRPCRequest& request)
 /* ************************************************************************** */
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         argNames
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "game",               "game_getplayerstate",    &game_getplayerstate,    {"name","hash"} },
-    { "game",               "game_getstate",          &game_getstate,          {"hash"} },
-    { "game",               "game_getpath",           &game_getpath,           {"from","to"} },
-    { "game",               "game_waitforchange",     &game_waitforchange,     {"hash"} },
+{ //  category              name                      actor (function)         argNames   parallelBatch
+  //  --------------------- ------------------------  -----------------------  ---------- -------------
+    { "game",               "game_getplayerstate",    &game_getplayerstate,    {"name","hash"}, true },
+    { "game",               "game_getplayerstates",   &game_getplayerstates,   {"names","hash"}, true },
+    { "game",               "game_getstate",          &game_getstate,          {"hash"}, true },
+    { "game",               "game_getregion",         &game_getregion,         {"corner1","corner2","hash"}, true },
+    { "game",               "game_previewstep",       &game_previewstep,       {"diff"} },
+    { "game",               "game_getpath",           &game_getpath,           {"from","to"}, true },
+    { "game",               "game_playerhistory",     &game_playerhistory,     {"name","fromheight","count"}, true },
+    { "game",               "game_waitforchange",     &game_waitforchange,     {"hash","diff"} },
+    { "game",               "dumpgamestate",          &dumpgamestate,          {"path","blockhash"} },
+    { "game",               "loadgamestate",          &loadgamestate,          {"path","hash"} },
 };
 
 void RegisterGameRPCCommands(CRPCTable &t)
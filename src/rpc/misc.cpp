@@ -9,6 +9,7 @@
 #include <crypto/ripemd160.h>
 #include <game/db.h>
 #include <game/state.h>
+#include <index/statsindex.h>
 #include <init.h>
 #include <key_io.h>
 #include <validation.h>
@@ -282,6 +283,17 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCGameMemoryInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    if (pgameDb) {
+        obj.pushKV("states", uint64_t(pgameDb->cachedStates()));
+        obj.pushKV("usage", uint64_t(pgameDb->dynamicMemoryUsage()));
+        obj.pushKV("limit", uint64_t(pgameDb->cacheLimit()));
+    }
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -323,6 +335,11 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"game\": {                 (json object) Information about the in-memory game state cache\n"
+            "    \"states\": xxxxx,        (numeric) Number of game states held in memory\n"
+            "    \"usage\": xxxxx,         (numeric) Number of bytes used by them\n"
+            "    \"limit\": xxxxx,         (numeric) Memory limit of the cache in bytes (-gamecache)\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -336,6 +353,7 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("game", RPCGameMemoryInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -460,6 +478,37 @@ static UniValue getinfo_deprecated(const JSONRPCRequest& request)
     );
 }
 
+namespace
+{
+
+/**
+ * Convert block statistics to the JSON format used by getstatsforheight.
+ */
+UniValue
+BlockStatsToJSON (const CBlockStats& stats, const int nHeight)
+{
+  UniValue transactions(UniValue::VOBJ);
+  transactions.pushKV ("currency", static_cast<int> (stats.nCurrencyTx));
+  transactions.pushKV ("name", static_cast<int> (stats.nNameTx));
+  transactions.pushKV ("game", static_cast<int> (stats.nGameTx));
+
+  UniValue game(UniValue::VOBJ);
+  game.pushKV ("players", static_cast<int> (stats.nPlayers));
+  game.pushKV ("hunters", static_cast<int> (stats.nHunters));
+
+  UniValue ret(UniValue::VOBJ);
+  ret.pushKV ("blockhash", stats.hashBlock.GetHex ());
+  ret.pushKV ("height", nHeight);
+  ret.pushKV ("time", static_cast<int> (stats.nTime));
+  ret.pushKV ("size", static_cast<int> (stats.nSize));
+  ret.pushKV ("transactions", transactions);
+  ret.pushKV ("game", game);
+
+  return ret;
+}
+
+} // anonymous namespace
+
 UniValue
 getstatsforheight (const JSONRPCRequest& request)
 {
@@ -486,17 +535,28 @@ getstatsforheight (const JSONRPCRequest& request)
       "  },\n"
       "}\n"
       "\nExamples:\n"
-      + HelpExampleCli("getstats", "12345")
-      + HelpExampleRpc("getstats", "12345")
+      + HelpExampleCli ("getstatsforheight", "12345")
+      + HelpExampleRpc ("getstatsforheight", "12345")
     );
 
-  LOCK(cs_main);
-
   const int nHeight = request.params[0].get_int ();
-  if (nHeight < 0 || nHeight > chainActive.Height ())
-    throw JSONRPCError (RPC_INVALID_PARAMETER, "Block height out of range");
 
-  const CBlockIndex* pblockindex = chainActive[nHeight];
+  const CBlockIndex* pblockindex;
+  {
+    LOCK (cs_main);
+    if (nHeight < 0 || nHeight > chainActive.Height ())
+      throw JSONRPCError (RPC_INVALID_PARAMETER, "Block height out of range");
+    pblockindex = chainActive[nHeight];
+  }
+
+  /* Use the stats index if it is enabled and has the block already.  */
+  CBlockStats stats;
+  if (g_statsindex && g_statsindex->BlockUntilSyncedToCurrentChain ()
+        && g_statsindex->LookupStats (pblockindex, stats))
+    return BlockStatsToJSON (stats, nHeight);
+
+  LOCK (cs_main);
+
   if (fHavePruned
         && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
     throw JSONRPCError (RPC_INTERNAL_ERROR,
@@ -507,54 +567,66 @@ getstatsforheight (const JSONRPCRequest& request)
   if(!ReadBlockFromDisk (block, vGameTx, pblockindex,
                          Params ().GetConsensus ()))
     throw JSONRPCError (RPC_INTERNAL_ERROR, "Can't read block from disk");
-  const int nSize = GetSerializeSize (block, SER_NETWORK, PROTOCOL_VERSION);
-
-  UniValue transactions(UniValue::VOBJ);
-  unsigned nCurrencyTx = 0;
-  unsigned nNameTx = 0;
-  for (const auto& tx : block.vtx)
-    {
-      bool isNameTx = false;
-      for (const auto& txout : tx->vout)
-        {
-          const CNameScript op(txout.scriptPubKey);
-          if (op.isNameOp ())
-            {
-              isNameTx = true;
-              break;
-            }
-        }
-
-      if (isNameTx)
-        ++nNameTx;
-      else
-        ++nCurrencyTx;
-    }
-  assert (nNameTx + nCurrencyTx == block.vtx.size ());
-  transactions.pushKV ("currency", static_cast<int> (nCurrencyTx));
-  transactions.pushKV ("name", static_cast<int> (nNameTx));
-  transactions.pushKV ("game", static_cast<int> (vGameTx.size ()));
 
   GameState gameState(Params ().GetConsensus ());
   if (!pgameDb->get (block.GetHash (), gameState))
     throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
-  unsigned nHunters = 0;
-  for (const auto& cur : gameState.players)
-    nHunters += cur.second.characters.size ();
-  UniValue game(UniValue::VOBJ);
-  const unsigned nPlayers = gameState.players.size ();
-  game.pushKV ("players", static_cast<int> (nPlayers));
-  game.pushKV ("hunters", static_cast<int> (nHunters));
 
-  UniValue ret(UniValue::VOBJ);
-  ret.pushKV ("blockhash", block.GetHash ().GetHex ());
-  ret.pushKV ("height", nHeight);
-  ret.pushKV ("time", static_cast<int> (block.nTime));
-  ret.pushKV ("size", nSize);
-  ret.pushKV ("transactions", transactions);
-  ret.pushKV ("game", game);
+  ComputeBlockStats (block, vGameTx, gameState, stats);
+  return BlockStatsToJSON (stats, nHeight);
+}
 
-  return ret;
+UniValue
+getstatsforheightrange (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size() != 2)
+    throw std::runtime_error (
+      "getstatsforheightrange from count\n"
+      "\nGet the statistics of getstatsforheight for a range of blocks.\n"
+      "This requires -statsindex.\n"
+      "\nArguments:\n"
+      "1. from    (integer, required) The first block height to return\n"
+      "2. count   (integer, required) Number of blocks to return at most\n"
+      "\nResult:\n"
+      "[\n"
+      "  {...},   (object) Statistics as per getstatsforheight\n"
+      "  ...\n"
+      "]\n"
+      "\nExamples:\n"
+      + HelpExampleCli ("getstatsforheightrange", "12345 1000")
+      + HelpExampleRpc ("getstatsforheightrange", "12345, 1000")
+    );
+
+  if (!g_statsindex)
+    throw JSONRPCError (RPC_MISC_ERROR, "the stats index is not enabled");
+
+  const int from = request.params[0].get_int ();
+  const int count = request.params[1].get_int ();
+  if (from < 0 || count < 0)
+    throw JSONRPCError (RPC_INVALID_PARAMETER, "Block height out of range");
+
+  if (!g_statsindex->BlockUntilSyncedToCurrentChain ())
+    throw JSONRPCError (RPC_MISC_ERROR, "the stats index is still syncing");
+
+  std::vector<const CBlockIndex*> blocks;
+  {
+    LOCK (cs_main);
+    for (int h = from; h <= chainActive.Height () && h - from < count; ++h)
+      blocks.push_back (chainActive[h]);
+  }
+
+  UniValue res(UniValue::VARR);
+  for (const auto* pindex : blocks)
+    {
+      CBlockStats stats;
+      if (!g_statsindex->LookupStats (pindex, stats))
+        throw JSONRPCError (RPC_DATABASE_ERROR,
+                            strprintf ("no stats for block %s",
+                                       pindex->GetBlockHash ().GetHex ()));
+      res.push_back (BlockStatsToJSON (stats, pindex->nHeight));
+    }
+
+  return res;
 }
 
 static const CRPCCommand commands[] =
@@ -567,6 +639,7 @@ static const CRPCCommand commands[] =
     { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, {"privkey","message"} },
     { "blockchain",         "getstatsforheight",      &getstatsforheight,      {"height"} },
+    { "blockchain",         "getstatsforheightrange", &getstatsforheightrange, {"from","count"} },
 
     /* Not shown in help */
     { "hidden",             "setmocktime",            &setmocktime,            {"timestamp"}},
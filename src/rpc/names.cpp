@@ -8,6 +8,7 @@
 #include <init.h>
 #include <key_io.h>
 #include <names/common.h>
+#include <names/index.h>
 #include <names/main.h>
 #include <primitives/transaction.h>
 #include <rpc/server.h>
@@ -22,6 +23,7 @@
 
 #include <boost/xpressive/xpressive_dynamic.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <sstream>
@@ -173,13 +175,16 @@ name_show (const JSONRPCRequest& request)
 UniValue
 name_history (const JSONRPCRequest& request)
 {
-  if (request.fHelp || request.params.size () != 1)
+  if (request.fHelp || request.params.size () < 1
+        || request.params.size () > 3)
     throw std::runtime_error (
-        "name_history \"name\"\n"
+        "name_history \"name\" (\"from\" (\"count\"))\n"
         "\nLook up the current and all past data for the given name."
         "  -namehistory must be enabled.\n"
         "\nArguments:\n"
         "1. \"name\"          (string, required) the name to query for\n"
+        "2. \"from\"          (numeric, optional, default=0) skip this many of the oldest entries\n"
+        "3. \"count\"         (numeric, optional, default=0) return at most this many entries; 0 means all\n"
         "\nResult:\n"
         "[\n"
         + NameInfoHelp ("  ").withHeight ().finish (",") +
@@ -187,10 +192,12 @@ name_history (const JSONRPCRequest& request)
         "]\n"
         "\nExamples:\n"
         + HelpExampleCli ("name_history", "\"myname\"")
+        + HelpExampleCli ("name_history", "\"myname\" 100 10")
         + HelpExampleRpc ("name_history", "\"myname\"")
       );
 
-  RPCTypeCheck (request.params, {UniValue::VSTR});
+  RPCTypeCheck (request.params,
+                {UniValue::VSTR, UniValue::VNUM, UniValue::VNUM});
 
   if (!fNameHistory)
     throw std::runtime_error ("-namehistory is not enabled");
@@ -202,12 +209,28 @@ name_history (const JSONRPCRequest& request)
   const std::string nameStr = request.params[0].get_str ();
   const valtype name = ValtypeFromString (nameStr);
 
-  CNameData data;
-  CNameHistory history;
+  int from = 0;
+  if (request.params.size () >= 2)
+    from = request.params[1].get_int ();
+  if (from < 0)
+    throw JSONRPCError (RPC_INVALID_PARAMETER, "'from' should be non-negative");
+
+  int count = 0;
+  if (request.params.size () >= 3)
+    count = request.params[2].get_int ();
+  if (count < 0)
+    throw JSONRPCError (RPC_INVALID_PARAMETER,
+                        "'count' should be non-negative");
+
+  /* The history entries are stored individually in the database, so that
+     we only need to read the requested page.  The current data of the name
+     is the last entry, after all history entries.  */
+  std::vector<CNameData> entries;
 
   {
     LOCK (cs_main);
 
+    CNameData data;
     if (!pcoinsTip->GetName (name, data))
       {
         std::ostringstream msg;
@@ -215,14 +238,32 @@ name_history (const JSONRPCRequest& request)
         throw JSONRPCError (RPC_WALLET_ERROR, msg.str ());
       }
 
-    if (!pcoinsTip->GetNameHistory (name, history))
-      assert (history.empty ());
+    const unsigned size = pcoinsTip->GetNameHistorySize (name);
+    unsigned end = size + 1;
+    /* Compute the requested end in 64 bits, so that large values of 'from'
+       and 'count' cannot overflow.  */
+    if (count > 0)
+      end = std::min<int64_t> (end, static_cast<int64_t> (from) + count);
+
+    for (unsigned i = from; i < end; ++i)
+      {
+        if (i == size)
+          {
+            entries.push_back (data);
+            break;
+          }
+
+        CNameData entry;
+        if (!pcoinsTip->GetNameHistoryEntry (name, i, entry))
+          throw JSONRPCError (RPC_DATABASE_ERROR,
+                              "failed to read name history entry");
+        entries.push_back (entry);
+      }
   }
 
   UniValue res(UniValue::VARR);
-  for (const auto& entry : history.getData ())
+  for (const auto& entry : entries)
     res.push_back (getNameInfo (name, entry));
-  res.push_back (getNameInfo (name, data));
 
   return res;
 }
@@ -269,11 +310,28 @@ name_scan (const JSONRPCRequest& request)
   if (count <= 0)
     return res;
 
-  LOCK (cs_main);
+  /* If the name index is available, use it.  It has its own lock, so that
+     we do not need to block cs_main while scanning.  */
+  if (pnameIndex)
+    {
+      CNameIndex::EntryList entries;
+      pnameIndex->scan (start, count, entries);
+      for (const auto& entry : entries)
+        res.push_back (getNameInfo (entry.first, entry.second));
+
+      return res;
+    }
+
+  /* Only hold cs_main while creating the snapshot iterator, so that block
+     connection can proceed while we scan.  */
+  std::unique_ptr<CNameIterator> iter;
+  {
+    LOCK (cs_main);
+    iter.reset (pcoinsTip->IterateNamesSnapshot ());
+  }
 
   valtype name;
   CNameData data;
-  std::unique_ptr<CNameIterator> iter(pcoinsTip->IterateNames ());
   for (iter->seek (start); count > 0 && iter->next (name, data); --count)
     res.push_back (getNameInfo (name, data));
 
@@ -288,7 +346,9 @@ name_filter (const JSONRPCRequest& request)
   if (request.fHelp || request.params.size () > 5)
     throw std::runtime_error (
         "name_filter (\"regexp\" (\"maxage\" (\"from\" (\"nb\" (\"stat\")))))\n"
-        "\nScan and list names matching a regular expression.\n"
+        "\nScan and list names matching a regular expression.  \"^\" and \"$\""
+        " match only at the start and end of names, even if they contain"
+        " line breaks.\n"
         "\nArguments:\n"
         "1. \"regexp\"      (string, optional) filter names with this regexp\n"
         "2. \"maxage\"      (numeric, optional, default=36000) only consider names updated in the last \"maxage\" blocks; 0 means all names\n"
@@ -327,7 +387,9 @@ name_filter (const JSONRPCRequest& request)
   if (request.params.size () >= 1)
     {
       haveRegexp = true;
-      regexp = boost::xpressive::sregex::compile (request.params[0].get_str ());
+      regexp = boost::xpressive::sregex::compile (
+          request.params[0].get_str (),
+          boost::xpressive::regex_constants::single_line);
     }
 
   if (request.params.size () >= 2)
@@ -358,31 +420,30 @@ name_filter (const JSONRPCRequest& request)
 
   UniValue names(UniValue::VARR);
   unsigned count(0);
+  int height;
 
-  LOCK (cs_main);
-
-  valtype name;
-  CNameData data;
-  std::unique_ptr<CNameIterator> iter(pcoinsTip->IterateNames ());
-  while (iter->next (name, data))
+  /* Process a single name.  Returns false if the iteration should be
+     stopped because enough names have been found.  */
+  const auto processName = [&] (const valtype& name, const CNameData& data)
+      -> bool
     {
-      const int age = chainActive.Height () - data.getHeight ();
+      const int age = height - data.getHeight ();
       assert (age >= 0);
       if (maxage != 0 && age >= maxage)
-        continue;
+        return true;
 
       if (haveRegexp)
         {
           const std::string nameStr = ValtypeToString (name);
           boost::xpressive::smatch matches;
           if (!boost::xpressive::regex_search (nameStr, matches, regexp))
-            continue;
+            return true;
         }
 
       if (from > 0)
         {
           --from;
-          continue;
+          return true;
         }
       assert (from == 0);
 
@@ -395,8 +456,39 @@ name_filter (const JSONRPCRequest& request)
         {
           --nb;
           if (nb == 0)
-            break;
+            return false;
         }
+
+      return true;
+    };
+
+  if (pnameIndex)
+    {
+      /* The name index narrows down the candidates based on literals in the
+         regexp and the maximum age, and does not require cs_main.  */
+      const std::string pattern = (haveRegexp ? request.params[0].get_str ()
+                                              : "");
+      CNameIndex::EntryList candidates;
+      height = pnameIndex->findCandidates (haveRegexp ? &pattern : nullptr,
+                                           maxage, candidates);
+      for (const auto& entry : candidates)
+        if (!processName (entry.first, entry.second))
+          break;
+    }
+  else
+    {
+      std::unique_ptr<CNameIterator> iter;
+      {
+        LOCK (cs_main);
+        height = chainActive.Height ();
+        iter.reset (pcoinsTip->IterateNamesSnapshot ());
+      }
+
+      valtype name;
+      CNameData data;
+      while (iter->next (name, data))
+        if (!processName (name, data))
+          break;
     }
 
   /* ********************************************************** */
@@ -405,7 +497,7 @@ name_filter (const JSONRPCRequest& request)
   if (stats)
     {
       UniValue res(UniValue::VOBJ);
-      res.pushKV ("blocks", chainActive.Height ());
+      res.pushKV ("blocks", height);
       res.pushKV ("count", static_cast<int> (count));
 
       return res;
@@ -684,10 +776,10 @@ name_checkdb (const JSONRPCRequest& request)
 /* ************************************************************************** */
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         argNames
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "names",              "name_show",              &name_show,              {"name"} },
-    { "names",              "name_history",           &name_history,           {"name"} },
+{ //  category              name                      actor (function)         argNames   parallelBatch
+  //  --------------------- ------------------------  -----------------------  ---------- -------------
+    { "names",              "name_show",              &name_show,              {"name"}, true },
+    { "names",              "name_history",           &name_history,           {"name","from","count"}, true },
     { "names",              "name_scan",              &name_scan,              {"start","count"} },
     { "names",              "name_filter",            &name_filter,            {"regexp","maxage","from","nb","stat"} },
     { "names",              "name_pending",           &name_pending,           {"name"} },
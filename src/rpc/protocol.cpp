@@ -50,6 +50,77 @@ std::string JSONRPCReply(const UniValue& result, const UniValue& error, const Un
     return reply.write() + "\n";
 }
 
+JSONStreamWriter::JSONStreamWriter(const Sink& sinkIn)
+    : sink(sinkIn)
+{
+    buffer.reserve(CHUNK_SIZE);
+}
+
+void JSONStreamWriter::Write(const UniValue& val)
+{
+    switch (val.getType()) {
+    case UniValue::VOBJ: {
+        const std::vector<std::string>& keys = val.getKeys();
+        const std::vector<UniValue>& values = val.getValues();
+        buffer += '{';
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (i > 0)
+                buffer += ',';
+            buffer += UniValue(keys[i]).write();
+            buffer += ':';
+            Write(values[i]);
+        }
+        buffer += '}';
+        break;
+    }
+
+    case UniValue::VARR: {
+        const std::vector<UniValue>& values = val.getValues();
+        buffer += '[';
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i > 0)
+                buffer += ',';
+            Write(values[i]);
+        }
+        buffer += ']';
+        break;
+    }
+
+    default:
+        buffer += val.write();
+        if (buffer.size() >= CHUNK_SIZE)
+            Flush();
+        break;
+    }
+}
+
+void JSONStreamWriter::WriteRaw(const std::string& str)
+{
+    buffer += str;
+    if (buffer.size() >= CHUNK_SIZE)
+        Flush();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (!buffer.empty())
+        sink(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void JSONRPCWriteReply(JSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id)
+{
+    // Keep this in sync with JSONRPCReplyObj.  The result is not copied
+    // into a reply object, but written in place.
+    writer.WriteRaw("{\"result\":");
+    writer.Write(error.isNull() ? result : NullUniValue);
+    writer.WriteRaw(",\"error\":");
+    writer.Write(error);
+    writer.WriteRaw(",\"id\":");
+    writer.Write(id);
+    writer.WriteRaw("}\n");
+}
+
 UniValue JSONRPCError(int code, const std::string& message)
 {
     UniValue error(UniValue::VOBJ);
@@ -8,6 +8,7 @@
 
 #include <fs.h>
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -95,6 +96,37 @@ enum RPCErrorCode
 UniValue JSONRPCRequestObj(const std::string& strMethod, const UniValue& params, const UniValue& id);
 UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
+
+/**
+ * Serialises JSON values piecewise into a sink.  Unlike UniValue::write,
+ * this never holds the text of the whole value (or of nested parts of it)
+ * in a string, which bounds the memory needed for large RPC replies.  The
+ * output is the same as that of UniValue::write without indentation.
+ */
+class JSONStreamWriter
+{
+public:
+    /** Receives the serialised data in chunks */
+    typedef std::function<void(const char* data, size_t len)> Sink;
+
+    explicit JSONStreamWriter(const Sink& sinkIn);
+
+    void Write(const UniValue& val);
+    void WriteRaw(const std::string& str);
+
+    /** Pass all buffered data to the sink.  Call this when done writing. */
+    void Flush();
+
+private:
+    /** Data is passed to the sink in chunks of roughly this size */
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    Sink sink;
+    std::string buffer;
+};
+
+/** Write the same reply as JSONRPCReply, but through a stream writer */
+void JSONRPCWriteReply(JSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
 /** Generate a new RPC authentication cookie and write it to disk */
@@ -20,7 +20,10 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
 #include <memory> // for unique_ptr
+#include <set>
+#include <thread>
 #include <unordered_map>
 
 static CCriticalSection cs_rpcWarmup;
@@ -413,13 +416,64 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+static bool IsParallelBatchCall(const UniValue& req)
 {
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->parallelBatch;
+}
+
+/** Execute the calls [begin, end) of a batch on up to nThreads threads */
+static void JSONRPCExecParallel(const JSONRPCRequest& jreq, const UniValue& vReq, size_t begin, size_t end,
+                                size_t nThreads, std::vector<UniValue>& results)
+{
+    std::atomic<size_t> next(begin);
+    const auto worker = [&]() {
+        for (size_t i = next++; i < end; i = next++)
+            results[i] = JSONRPCExecOne(jreq, vReq[i]);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(nThreads, end - begin); ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+UniValue JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+{
+    const size_t nThreads = std::max<int64_t>(gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 1);
+
+    // Runs of read-only calls are executed concurrently, all other calls
+    // one by one in order.  Thus calls that depend on earlier ones in the
+    // batch (e.g. sending a transaction and then querying it) still work.
+    std::vector<UniValue> results(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t end = reqIdx + 1;
+        if (IsParallelBatchCall(vReq[reqIdx])) {
+            while (end < vReq.size() && IsParallelBatchCall(vReq[end]))
+                ++end;
+        }
+        if (end - reqIdx > 1 && nThreads > 1)
+            JSONRPCExecParallel(jreq, vReq, reqIdx, end, nThreads, results);
+        else {
+            for (; reqIdx < end; ++reqIdx)
+                results[reqIdx] = JSONRPCExecOne(jreq, vReq[reqIdx]);
+        }
+        reqIdx = end;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    for (auto& res : results)
+        ret.push_back(std::move(res));
 
-    return ret.write() + "\n";
+    return ret;
 }
 
 /**
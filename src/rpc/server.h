@@ -21,6 +21,7 @@
 #include <univalue.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
 
 class CMutableTransaction;
 class COutPoint;
@@ -53,11 +54,28 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    /** Whether long-poll methods may throw RPCParkRequest instead of
+     * blocking.  This is set for single requests over HTTP. */
+    bool fParkable;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), fParkable(false) {}
     void parse(const UniValue& valRequest);
 };
 
+/**
+ * Thrown by long-poll methods for parkable requests instead of waiting for
+ * the chain tip to change.  The HTTP server then holds the request without
+ * occupying a worker thread, and executes it again with the given params
+ * when the tip changes.
+ */
+class RPCParkRequest
+{
+public:
+    UniValue params;
+
+    explicit RPCParkRequest(const UniValue& _params) : params(_params) {}
+};
+
 /** Query whether RPC is running */
 bool IsRPCRunning();
 
@@ -138,10 +156,16 @@ typedef UniValue(*rpcfn_type)(const JSONRPCRequest& jsonRequest);
 class CRPCCommand
 {
 public:
+    CRPCCommand(std::string _category, std::string _name, rpcfn_type _actor, std::vector<std::string> _argNames, bool _parallelBatch = false)
+        : category(std::move(_category)), name(std::move(_name)), actor(_actor), argNames(std::move(_argNames)), parallelBatch(_parallelBatch) {}
+
     std::string category;
     std::string name;
     rpcfn_type actor;
     std::vector<std::string> argNames;
+    /** Set for commands that only query the node's state.  Consecutive
+     * calls to them within a batch are executed concurrently. */
+    bool parallelBatch;
 };
 
 /**
@@ -237,7 +261,7 @@ extern PowAlgo DecodeAlgoParam(const UniValue& param);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+UniValue JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
@@ -0,0 +1,314 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <dbwrapper.h>
+#include <game/db.h>
+#include <game/state.h>
+#include <memusage.h>
+#include <test/test_bitcoin.h>
+#include <util.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(gamedb_tests)
+
+BOOST_FIXTURE_TEST_CASE(gamedb_warmup, TestChain100Setup)
+{
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+
+    GameState expected(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(tip->GetBlockHash(), expected));
+
+    // A fresh game DB does not have any states, so warming up replays the
+    // whole chain.  Afterwards, the tip's state is available.
+    CGameDB db(true, true);
+    db.warmUp();
+
+    GameState state(Params().GetConsensus());
+    BOOST_REQUIRE(db.get(tip->GetBlockHash(), state));
+    BOOST_CHECK(state.hashBlock == expected.hashBlock);
+    BOOST_CHECK_EQUAL(state.nHeight, expected.nHeight);
+    BOOST_CHECK_EQUAL(state.players.size(), expected.players.size());
+
+    // Shared handles to a cached state refer to the same instance.
+    const auto shared = db.getShared(tip->GetBlockHash());
+    BOOST_REQUIRE(shared);
+    BOOST_CHECK(shared == db.getShared(tip->GetBlockHash()));
+    BOOST_CHECK(GetGameStateHash(*shared) == GetGameStateHash(state));
+
+    // Warming up again is a no-op.
+    db.warmUp();
+    BOOST_REQUIRE(db.get(tip->GetBlockHash(), state));
+    BOOST_CHECK(state.hashBlock == expected.hashBlock);
+}
+
+BOOST_FIXTURE_TEST_CASE(gamedb_reindex, TestChain100Setup)
+{
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+
+    GameState expected(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(tip->GetBlockHash(), expected));
+
+    CGameDB db(true, true);
+    BOOST_CHECK(!db.isReindexing());
+    BOOST_CHECK(db.reindex());
+
+    db.startReindex();
+    BOOST_CHECK(db.isReindexing());
+    BOOST_CHECK(db.reindex());
+    BOOST_CHECK(!db.isReindexing());
+
+    GameState state(Params().GetConsensus());
+    BOOST_REQUIRE(db.get(tip->GetBlockHash(), state));
+    BOOST_CHECK(state.hashBlock == expected.hashBlock);
+    BOOST_CHECK_EQUAL(state.nHeight, expected.nHeight);
+    BOOST_CHECK_EQUAL(state.players.size(), expected.players.size());
+}
+
+BOOST_FIXTURE_TEST_CASE(gamedb_snapshot, TestChain100Setup)
+{
+    const CBlockIndex* tip;
+    const CBlockIndex* snapshotBlock;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+        snapshotBlock = chainActive[50];
+    }
+
+    GameState expected(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(tip->GetBlockHash(), expected));
+    GameState snapshot(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(snapshotBlock->GetBlockHash(), snapshot));
+
+    // Round-trip the snapshot through a file.
+    const fs::path path = GetDataDir() / "gamestate.dat";
+    uint256 hash;
+    BOOST_REQUIRE(WriteGameStateSnapshot(path, snapshot, hash));
+    BOOST_CHECK(hash == GetGameStateHash(snapshot));
+
+    GameState loaded(Params().GetConsensus());
+    uint256 loadedHash;
+    std::string err;
+    BOOST_REQUIRE(ReadGameStateSnapshot(path, loaded, loadedHash, err));
+    BOOST_CHECK(loadedHash == hash);
+    BOOST_CHECK(GetGameStateHash(loaded) == hash);
+    BOOST_CHECK(loaded.hashBlock == snapshotBlock->GetBlockHash());
+
+    // Import into a fresh game DB and compute later states from it.
+    {
+        CGameDB db(true, true);
+        BOOST_REQUIRE(db.importState(loaded));
+        GameState state(Params().GetConsensus());
+        BOOST_REQUIRE(db.get(tip->GetBlockHash(), state));
+        BOOST_CHECK(GetGameStateHash(state) == GetGameStateHash(expected));
+
+        // A state not matching the known one is rejected.
+        loaded.gameFund += 1;
+        BOOST_CHECK(!db.importState(loaded));
+    }
+
+    // Corrupted snapshots fail the hash commitment check.
+    {
+        FILE* file = fsbridge::fopen(path, "r+b");
+        BOOST_REQUIRE(file != nullptr);
+        BOOST_REQUIRE(fseek(file, -40, SEEK_END) == 0);
+        char byte;
+        BOOST_REQUIRE(fread(&byte, 1, 1, file) == 1);
+        byte ^= 0xFF;
+        BOOST_REQUIRE(fseek(file, -40, SEEK_END) == 0);
+        BOOST_REQUIRE(fwrite(&byte, 1, 1, file) == 1);
+        fclose(file);
+    }
+    BOOST_CHECK(!ReadGameStateSnapshot(path, loaded, loadedHash, err));
+    BOOST_CHECK_EQUAL(err, "snapshot does not match its hash commitment");
+
+    fs::remove(path);
+}
+
+BOOST_FIXTURE_TEST_CASE(gamestate_memory_usage, BasicTestingSetup)
+{
+    GameState state(Params().GetConsensus());
+    const size_t empty = state.DynamicMemoryUsage();
+
+    PlayerState& player = state.players["some player with a long name"];
+    const size_t withPlayer = state.DynamicMemoryUsage();
+    BOOST_CHECK(withPlayer > empty);
+
+    player.message = std::string(1000, 'x');
+    BOOST_CHECK(state.DynamicMemoryUsage() >= withPlayer + 1000);
+    BOOST_CHECK_EQUAL(state.DynamicMemoryUsage() - withPlayer, player.DynamicMemoryUsage() - PlayerState().DynamicMemoryUsage());
+
+    CharacterState& ch = player.characters[0];
+    ch.waypoints.resize(100);
+    BOOST_CHECK(ch.DynamicMemoryUsage() >= 100 * sizeof(Coord));
+    BOOST_CHECK(player.DynamicMemoryUsage() >= ch.DynamicMemoryUsage() + 1000);
+}
+
+BOOST_FIXTURE_TEST_CASE(gamedb_cache_policy, TestingSetup)
+{
+    // Build a fake main chain, whose block hashes are not in mapBlockIndex.
+    // States that are evicted from the cache and not written to disk can thus
+    // not be recomputed, which makes the cache policy observable.
+    std::vector<uint256> hashes(20);
+    std::vector<CBlockIndex> indices(20);
+    for (int h = 0; h < 20; ++h) {
+        hashes[h] = uint256S(strprintf("%x", 0x1000 + h));
+        indices[h].phashBlock = &hashes[h];
+        indices[h].nHeight = h;
+        indices[h].pprev = (h > 0 ? &indices[h - 1] : nullptr);
+    }
+
+    const auto makeState = [](const uint256& hash, int height) {
+        GameState state(Params().GetConsensus());
+        state.hashBlock = hash;
+        state.nHeight = height;
+        return state;
+    };
+    const auto sideHash = [](int height) { return uint256S(strprintf("%x", 0x2000 + height)); };
+
+    // Limit the cache to roughly 40 states, so that storing the states below
+    // triggers multiple flushes.
+    const GameState empty(Params().GetConsensus());
+    const size_t limit = 40 * (memusage::MallocUsage(sizeof(GameState)) + empty.DynamicMemoryUsage());
+    CGameDB db(true, true, limit);
+    BOOST_CHECK_EQUAL(db.cacheLimit(), limit);
+    db.setTip(&indices.back());
+
+    // Store the main chain and then the side-branch states.  No cs_main is
+    // held here, which flush() does not need.
+    for (int h = 0; h < 20; ++h) {
+        db.store(hashes[h], makeState(hashes[h], h));
+    }
+    for (int h = 1; h <= 200; ++h) {
+        db.store(sideHash(h), makeState(sideHash(h), h));
+        BOOST_CHECK(db.dynamicMemoryUsage() <= limit);
+    }
+    BOOST_CHECK(db.cachedStates() >= 10);
+    BOOST_CHECK(db.cachedStates() < 40);
+
+    GameState state(Params().GetConsensus());
+
+    // The last ten main-chain states are kept in memory.
+    for (int h = 10; h < 20; ++h) {
+        BOOST_CHECK(db.get(hashes[h], state));
+    }
+    // The older main-chain states were evicted, except for the genesis
+    // state that fits the keep-every-nth policy and is on disk.
+    BOOST_CHECK(db.get(hashes[0], state));
+    for (int h = 1; h < 10; ++h) {
+        BOOST_CHECK(!db.get(hashes[h], state));
+    }
+
+    // Of the other states, the ones with the highest heights are kept.
+    BOOST_CHECK(db.get(sideHash(200), state));
+    BOOST_CHECK(db.get(sideHash(199), state));
+    BOOST_CHECK(!db.get(sideHash(1), state));
+}
+
+BOOST_FIXTURE_TEST_CASE(gamedb_shutdown_flush, TestingSetup)
+{
+    // Use a state whose block is not in mapBlockIndex, so that it can only
+    // be found if it has been written to disk.
+    const uint256 hash = uint256S("1234");
+    GameState state(Params().GetConsensus());
+    state.hashBlock = hash;
+    state.nHeight = 5;
+    pgameDb->store(hash, state);
+
+    // The background writer finishes all writes when shutting down.
+    pgameDb.reset();
+    pgameDb.reset(new CGameDB(false, false));
+    GameState loaded(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(hash, loaded));
+    BOOST_CHECK_EQUAL(loaded.nHeight, 5);
+
+    // The state does not fit the keep-every-nth policy, so it is removed
+    // from disk with the next flush.
+    pgameDb.reset();
+    pgameDb.reset(new CGameDB(false, false));
+    BOOST_CHECK(!pgameDb->get(hash, loaded));
+}
+
+BOOST_FIXTURE_TEST_CASE(gamedb_import_transient, TestingSetup)
+{
+    // Write a state to disk only transiently at shutdown, as above.
+    const uint256 hash = uint256S("5678");
+    GameState state(Params().GetConsensus());
+    state.hashBlock = hash;
+    state.nHeight = 7;
+    pgameDb->store(hash, state);
+    pgameDb.reset();
+
+    // Importing the same state makes it permanent.
+    pgameDb.reset(new CGameDB(false, false));
+    BOOST_REQUIRE(pgameDb->importState(state));
+    pgameDb.reset();
+
+    // Another flush purges the transient states, but not the imported one.
+    pgameDb.reset(new CGameDB(false, false));
+    const uint256 other = uint256S("9abc");
+    GameState otherState(Params().GetConsensus());
+    otherState.hashBlock = other;
+    otherState.nHeight = 9;
+    pgameDb->store(other, otherState);
+    pgameDb.reset();
+
+    pgameDb.reset(new CGameDB(false, false));
+    GameState loaded(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(hash, loaded));
+    BOOST_CHECK_EQUAL(loaded.nHeight, 7);
+}
+
+BOOST_FIXTURE_TEST_CASE(gamedb_legacy_shutdown_states, TestingSetup)
+{
+    const auto makeState = [](const uint256& hash, int height) {
+        GameState state(Params().GetConsensus());
+        state.hashBlock = hash;
+        state.nHeight = height;
+        return state;
+    };
+    const uint256 kept = uint256S("2000");
+    const uint256 recent = uint256S("2001");
+
+    // Write states like older versions did at shutdown, without marking
+    // them as transient, and remove the marker of the upgrade.
+    pgameDb.reset();
+    {
+        CDBWrapper db(GetDataDir() / "gamestates", 1 << 20, false, false, true);
+        CDBBatch batch(db);
+        batch.Write(std::make_pair('g', kept), makeState(kept, 2000));
+        batch.Write(std::make_pair('g', recent), makeState(recent, 2001));
+        batch.Erase('u');
+        BOOST_REQUIRE(db.WriteBatch(batch, true));
+    }
+
+    // The states are still there after opening the database, so that they
+    // can be used for warming up.
+    pgameDb.reset(new CGameDB(false, false));
+    GameState loaded(Params().GetConsensus());
+    BOOST_CHECK(pgameDb->get(recent, loaded));
+
+    // The next flush removes the state not fitting the keep-every-nth policy.
+    const uint256 other = uint256S("9abc");
+    pgameDb->store(other, makeState(other, 9));
+    pgameDb.reset();
+
+    pgameDb.reset(new CGameDB(false, false));
+    BOOST_CHECK(!pgameDb->get(recent, loaded));
+    BOOST_REQUIRE(pgameDb->get(kept, loaded));
+    BOOST_CHECK_EQUAL(loaded.nHeight, 2000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
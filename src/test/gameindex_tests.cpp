@@ -0,0 +1,157 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <game/common.h>
+#include <game/state.h>
+#include <game/tx.h>
+#include <index/gameindex.h>
+#include <names/common.h>
+#include <script/names.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(gameindex_tests)
+
+BOOST_AUTO_TEST_CASE(character_id_from_string)
+{
+    CharacterID chid;
+    BOOST_CHECK(chid.FromString("domob"));
+    BOOST_CHECK_EQUAL(chid.player, "domob");
+    BOOST_CHECK_EQUAL(chid.index, 0);
+
+    BOOST_CHECK(chid.FromString("some player.12"));
+    BOOST_CHECK_EQUAL(chid.player, "some player");
+    BOOST_CHECK_EQUAL(chid.index, 12);
+    BOOST_CHECK_EQUAL(chid.ToString(), "some player.12");
+
+    BOOST_CHECK(!chid.FromString(""));
+    BOOST_CHECK(!chid.FromString(".3"));
+    BOOST_CHECK(!chid.FromString("domob."));
+    BOOST_CHECK(!chid.FromString("domob.x"));
+    BOOST_CHECK(!chid.FromString("domob.0"));
+}
+
+BOOST_AUTO_TEST_CASE(extract_events)
+{
+    const uint256 hash = uint256S("42");
+    CBlockIndex index;
+    index.phashBlock = &hash;
+    index.nHeight = 10;
+
+    CBlock block;
+    CMutableTransaction mtx;
+    mtx.SetNamecoin();
+    mtx.vout.emplace_back(COIN, CNameScript::buildNameFirstupdate(CScript(), ValtypeFromString("newbie"),
+                                                                  ValtypeFromString("{}"), valtype(20, 0)));
+    block.vtx.push_back(MakeTransactionRef(mtx));
+
+    CMutableTransaction kills;
+    kills.SetGameTx();
+    kills.vin.emplace_back(COutPoint(uint256S("01"), 0));
+    kills.vin.back().scriptSig << ValtypeFromString("victim") << GAMEOP_KILLED_BY
+                               << ValtypeFromString("killer.2") << ValtypeFromString("other");
+    kills.vin.emplace_back(COutPoint(uint256S("02"), 0));
+    kills.vin.back().scriptSig << ValtypeFromString("camper") << GAMEOP_KILLED_BY;
+    kills.vin.emplace_back(COutPoint(uint256S("03"), 0));
+    kills.vin.back().scriptSig << ValtypeFromString("sick") << GAMEOP_KILLED_POISON;
+
+    CMutableTransaction bounties;
+    bounties.SetGameTx();
+    bounties.vin.emplace_back();
+    bounties.vin.back().scriptSig << ValtypeFromString("killer") << GAMEOP_COLLECTED_BOUNTY
+                                  << 3 << 1 << 2 << 1 << 2;
+    bounties.vout.emplace_back(5 * COIN, CScript());
+    bounties.vin.emplace_back();
+    bounties.vin.back().scriptSig << ValtypeFromString("camper") << GAMEOP_REFUND << 0 << 8;
+    bounties.vout.emplace_back(2 * COIN, CScript());
+
+    std::vector<CTransactionRef> vGameTx;
+    vGameTx.push_back(MakeTransactionRef(kills));
+    vGameTx.push_back(MakeTransactionRef(bounties));
+    BOOST_REQUIRE(vGameTx[1]->IsBountyTx());
+
+    GameEventMap events;
+    ExtractGameEvents(block, &index, vGameTx, events);
+    BOOST_CHECK_EQUAL(events.size(), 6);
+
+    BOOST_REQUIRE_EQUAL(events["newbie"].size(), 1);
+    BOOST_CHECK_EQUAL(events["newbie"][0].type, CGameEvent::SPAWN);
+    BOOST_CHECK_EQUAL(events["newbie"][0].nHeight, 10);
+    BOOST_CHECK(events["newbie"][0].hashBlock == hash);
+    BOOST_CHECK(events["newbie"][0].txid == block.vtx[0]->GetHash());
+
+    BOOST_REQUIRE_EQUAL(events["victim"].size(), 1);
+    const CGameEvent& death = events["victim"][0];
+    BOOST_CHECK_EQUAL(death.type, CGameEvent::DEATH);
+    BOOST_CHECK_EQUAL(death.reason, KilledByInfo::KILLED_DESTRUCT);
+    BOOST_CHECK(death.txid == vGameTx[0]->GetHash());
+    BOOST_REQUIRE_EQUAL(death.others.size(), 2);
+    BOOST_CHECK_EQUAL(death.others[0], "killer.2");
+    BOOST_CHECK_EQUAL(death.others[1], "other");
+
+    BOOST_REQUIRE_EQUAL(events["other"].size(), 1);
+    BOOST_CHECK_EQUAL(events["other"][0].type, CGameEvent::KILL);
+    BOOST_CHECK_EQUAL(events["other"][0].character, 0);
+
+    BOOST_REQUIRE_EQUAL(events["killer"].size(), 2);
+    BOOST_CHECK_EQUAL(events["killer"][0].type, CGameEvent::KILL);
+    BOOST_CHECK_EQUAL(events["killer"][0].character, 2);
+    BOOST_REQUIRE_EQUAL(events["killer"][0].others.size(), 1);
+    BOOST_CHECK_EQUAL(events["killer"][0].others[0], "victim");
+    BOOST_CHECK_EQUAL(events["killer"][1].type, CGameEvent::BOUNTY);
+    BOOST_CHECK_EQUAL(events["killer"][1].character, 3);
+    BOOST_CHECK_EQUAL(events["killer"][1].amount, 5 * COIN);
+
+    BOOST_REQUIRE_EQUAL(events["camper"].size(), 2);
+    BOOST_CHECK_EQUAL(events["camper"][0].type, CGameEvent::DEATH);
+    BOOST_CHECK_EQUAL(events["camper"][0].reason, KilledByInfo::KILLED_SPAWN);
+    BOOST_CHECK(events["camper"][0].others.empty());
+    BOOST_CHECK_EQUAL(events["camper"][1].type, CGameEvent::REFUND);
+    BOOST_CHECK_EQUAL(events["camper"][1].character, 0);
+    BOOST_CHECK_EQUAL(events["camper"][1].amount, 2 * COIN);
+
+    BOOST_REQUIRE_EQUAL(events["sick"].size(), 1);
+    BOOST_CHECK_EQUAL(events["sick"][0].type, CGameEvent::DEATH);
+    BOOST_CHECK_EQUAL(events["sick"][0].reason, KilledByInfo::KILLED_POISON);
+}
+
+BOOST_FIXTURE_TEST_CASE(gameindex_initial_sync, TestChain100Setup)
+{
+    GameIndex gameindex(1 << 20, true);
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started.
+    BOOST_CHECK(!gameindex.BlockUntilSyncedToCurrentChain());
+
+    gameindex.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!gameindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // The test chain has no players, so there should be no events.
+    std::vector<CGameEvent> events;
+    int next;
+    BOOST_REQUIRE(gameindex.FindPlayerEvents("domob", 0, 10, events, next));
+    BOOST_CHECK(events.empty());
+    BOOST_CHECK_EQUAL(next, -1);
+
+    // Check that the index keeps up with new blocks.
+    for (int i = 0; i < 10; i++) {
+        CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+        std::vector<CMutableTransaction> no_txns;
+        CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+        BOOST_CHECK(gameindex.BlockUntilSyncedToCurrentChain());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,218 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <game/db.h>
+#include <game/map.h>
+#include <game/state.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(gamemap_tests, BasicTestingSetup)
+
+/** Build a tile list the way it used to be done lazily on first use */
+static std::vector<Coord> LegacyWalkableTiles(const std::function<bool(int, int)>& predicate)
+{
+    std::vector<Coord> tiles;
+    for (int x = 0; x < MAP_WIDTH; ++x)
+        for (int y = 0; y < MAP_HEIGHT; ++y)
+            if (ObstacleMap[y][x] == 0 && predicate(x, y))
+                tiles.push_back(Coord(x, y));
+    std::sort(tiles.begin(), tiles.end());
+    return tiles;
+}
+
+BOOST_AUTO_TEST_CASE(walkable_map)
+{
+    for (int y = 0; y < MAP_HEIGHT; ++y)
+        for (int x = 0; x < MAP_WIDTH; ++x)
+            BOOST_REQUIRE_EQUAL(IsWalkable(x, y), ObstacleMap[y][x] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(walkable_tiles)
+{
+    BOOST_CHECK(WalkableTiles == LegacyWalkableTiles([](int x, int y) { return true; }));
+    BOOST_CHECK(PlayerSpawnTiles == LegacyWalkableTiles([](int x, int y) {
+        return (SpawnMap[y][x] & SPAWNMAPFLAG_PLAYER) != 0;
+    }));
+    BOOST_CHECK(BankSpawnTiles == LegacyWalkableTiles([](int x, int y) {
+        return (SpawnMap[y][x] & SPAWNMAPFLAG_BANK) != 0;
+    }));
+
+    BOOST_CHECK(!PlayerSpawnTiles.empty());
+    BOOST_CHECK(!BankSpawnTiles.empty());
+    BOOST_CHECK(PlayerSpawnTiles.size() < WalkableTiles.size());
+    BOOST_CHECK(BankSpawnTiles.size() < WalkableTiles.size());
+}
+
+/** Fill up the banks the way UpdateBanks used to, picking from a std::set */
+static void LegacyFillBanks(std::map<Coord, unsigned>& banks, const std::vector<Coord>& tiles, RandomGenerator& rng)
+{
+    std::set<Coord> optionsSet(tiles.begin(), tiles.end());
+    for (const auto& b : banks)
+        BOOST_REQUIRE_EQUAL(optionsSet.erase(b.first), 1);
+
+    std::vector<Coord> options(optionsSet.begin(), optionsSet.end());
+    while (banks.size() < 75) {
+        const int ind = rng.GetIntRnd(options.size());
+        const int life = rng.GetIntRnd(25, 100);
+        banks.emplace(options[ind], life);
+        options.erase(options.begin() + ind);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(update_banks)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    const unsigned lifeStealHeight = 795000;
+    const unsigned timeSaveHeight = 1521500;
+    BOOST_REQUIRE(params.rules->IsForkHeight(FORK_LIFESTEAL, lifeStealHeight));
+    BOOST_REQUIRE(params.rules->IsForkHeight(FORK_TIMESAVE, timeSaveHeight));
+
+    GameState state(params);
+    for (const unsigned height : {lifeStealHeight, lifeStealHeight + 1, timeSaveHeight, timeSaveHeight + 1}) {
+        state.nHeight = height;
+        const uint256 hash = uint256S(strprintf("%x", height));
+
+        // Let some of the banks run out now.
+        unsigned cnt = 0;
+        for (auto& b : state.banks)
+            if (++cnt % 3 == 0)
+                b.second = 1;
+
+        std::map<Coord, unsigned> legacy;
+        if (!params.rules->IsForkHeight(FORK_TIMESAVE, height)) {
+            for (const auto& b : state.banks)
+                if (b.second > 1)
+                    legacy.emplace(b.first, b.second - 1);
+        }
+        const bool timeSave = params.rules->ForkInEffect(FORK_TIMESAVE, height);
+        RandomGenerator legacyRng(hash);
+        LegacyFillBanks(legacy, timeSave ? BankSpawnTiles : WalkableTiles, legacyRng);
+
+        RandomGenerator rng(hash);
+        state.UpdateBanks(rng);
+        BOOST_CHECK(state.banks == legacy);
+        BOOST_CHECK_EQUAL(rng.GetIntRnd(1000000), legacyRng.GetIntRnd(1000000));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(heart_drop_tiles)
+{
+    for (int y = 0; y < MAP_HEIGHT; ++y)
+        for (int x = 0; x < MAP_WIDTH; ++x)
+            BOOST_REQUIRE_EQUAL(IsHeartDropTile(x, y), ObstacleMap[y][x] == 0 && !IsOriginalSpawnArea(x, y));
+
+    // Placing hearts by rejection sampling draws the same tiles and the same
+    // number of random numbers with either check.
+    for (int i = 0; i < 100; ++i) {
+        RandomGenerator rng(uint256S(strprintf("%x", i)));
+        RandomGenerator legacyRng(uint256S(strprintf("%x", i)));
+        Coord heart, legacy;
+        do {
+            heart.x = rng.GetIntRnd(MAP_WIDTH);
+            heart.y = rng.GetIntRnd(MAP_HEIGHT);
+        } while (!IsHeartDropTile(heart.x, heart.y));
+        do {
+            legacy.x = legacyRng.GetIntRnd(MAP_WIDTH);
+            legacy.y = legacyRng.GetIntRnd(MAP_HEIGHT);
+        } while (ObstacleMap[legacy.y][legacy.x] != 0 || IsOriginalSpawnArea(legacy.x, legacy.y));
+        BOOST_CHECK(heart == legacy);
+        BOOST_CHECK_EQUAL(rng.GetIntRnd(1000000), legacyRng.GetIntRnd(1000000));
+    }
+}
+
+/** CollectHearts as it was before indexing the heart rows and columns */
+static void LegacyCollectHearts(GameState& state, RandomGenerator& rnd)
+{
+    std::map<Coord, std::vector<PlayerState*> > playersOnHeartTile;
+    for (auto& p : state.players) {
+        PlayerState* pl = &p.second;
+        if (!pl->CanSpawnCharacter())
+            continue;
+        for (const auto& pc : pl->characters)
+            if (state.hearts.count(pc.second.coord))
+                playersOnHeartTile[pc.second.coord].push_back(pl);
+    }
+    for (auto& entry : playersOnHeartTile) {
+        std::vector<PlayerState*>& v = entry.second;
+        int n = v.size();
+        int i;
+        for (;;) {
+            if (!n) {
+                i = -1;
+                break;
+            }
+            i = n == 1 ? 0 : rnd.GetIntRnd(n);
+            if (v[i]->CanSpawnCharacter())
+                break;
+            v.erase(v.begin() + i);
+            n--;
+        }
+        if (i >= 0) {
+            v[i]->SpawnCharacter(state, rnd);
+            state.hearts.erase(entry.first);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(collect_hearts)
+{
+    for (int round = 0; round < 20; ++round) {
+        RandomGenerator setup(uint256S(strprintf("%x", 1000 + round)));
+        GameState state(Params().GetConsensus());
+        state.nHeight = 100000 + round;
+        BOOST_REQUIRE(!state.ForkInEffect(FORK_LIFESTEAL));
+
+        // Draw distinct positions, so that the number of hearts is known.
+        std::set<Coord> heartSet;
+        while (heartSet.size() < 30) {
+            const Coord c(setup.GetIntRnd(MAP_WIDTH), setup.GetIntRnd(MAP_HEIGHT));
+            if (IsHeartDropTile(c.x, c.y))
+                heartSet.insert(c);
+        }
+        state.hearts = heartSet;
+        const std::vector<Coord> hearts(heartSet.begin(), heartSet.end());
+
+        // Players with many characters may not be able to spawn another one
+        // after collecting a first heart, or not at all.
+        for (int p = 0; p < 40; ++p) {
+            PlayerState& pl = state.players[strprintf("player %d", p)];
+            pl.color = setup.GetIntRnd(4);
+            const int num = setup.GetIntRnd(1, 20);
+            for (int c = 0; c < num; ++c) {
+                Coord& coord = pl.characters[c].coord;
+                if (setup.GetIntRnd(3) == 0)
+                    coord = hearts[setup.GetIntRnd(hearts.size())];
+                else
+                    coord = Coord(setup.GetIntRnd(MAP_WIDTH), setup.GetIntRnd(MAP_HEIGHT));
+            }
+            pl.next_character_index = num;
+        }
+
+        GameState legacy(state);
+        const uint256 hash = uint256S(strprintf("%x", round));
+        RandomGenerator rng(hash);
+        RandomGenerator legacyRng(hash);
+        state.CollectHearts(rng);
+        LegacyCollectHearts(legacy, legacyRng);
+
+        // Some hearts were collected, and no new ones appeared.
+        BOOST_CHECK(state.hearts.size() < heartSet.size());
+        for (const auto& c : state.hearts)
+            BOOST_CHECK(heartSet.count(c) == 1);
+        BOOST_CHECK(state.hearts == legacy.hearts);
+        BOOST_CHECK(GetGameStateHash(state) == GetGameStateHash(legacy));
+        BOOST_CHECK_EQUAL(rng.GetIntRnd(1000000), legacyRng.GetIntRnd(1000000));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <game/common.h>
+#include <hash.h>
+#include <script/script.h>
+#include <test/test_bitcoin.h>
+#include <uint256.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <climits>
+#include <vector>
+
+namespace {
+
+/**
+ * The previous implementation of RandomGenerator, based on arith_uint256
+ * division.  It defines the consensus behaviour that the optimised
+ * generator must reproduce exactly.
+ */
+class LegacyRandomGenerator
+{
+public:
+    explicit LegacyRandomGenerator(const uint256& hashBlock)
+        : state0(SerializeHash(hashBlock, SER_GETHASH, 0))
+    {
+        state = UintToArith256(state0);
+    }
+
+    int GetIntRnd(int modulo)
+    {
+        if (state < MIN_STATE) {
+            valtype data(state0.begin(), state0.end());
+            while (data.back() == 0)
+                data.pop_back();
+            if (data.back() & 128)
+                data.push_back(0);
+
+            state0 = SerializeHash(data, SER_GETHASH, 0);
+            state = UintToArith256(state0);
+        }
+
+        arith_uint256 res = state;
+        state /= modulo;
+        res -= state * modulo;
+
+        assert(res.bits() < 64);
+        return res.GetLow64();
+    }
+
+private:
+    uint256 state0;
+    arith_uint256 state;
+    static const arith_uint256 MIN_STATE;
+};
+
+const arith_uint256 LegacyRandomGenerator::MIN_STATE = arith_uint256().SetCompact(0x097FFFFFu);
+
+/** Compare the draws of both generators for a sequence of moduli.  */
+void CheckSameDraws(const uint256& hash, const std::vector<int>& moduli, int rounds)
+{
+    RandomGenerator rnd(hash);
+    LegacyRandomGenerator legacy(hash);
+    for (int r = 0; r < rounds; ++r) {
+        for (const int mod : moduli) {
+            const int expected = legacy.GetIntRnd(mod);
+            const int actual = rnd.GetIntRnd(mod);
+            BOOST_REQUIRE_EQUAL(actual, expected);
+        }
+    }
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(gamerandom_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(matches_legacy_generator)
+{
+    const std::vector<uint256> hashes = {
+        // Mainnet genesis block.
+        uint256S("00000000db7eb7a9e1a06cf995363dcdc4c28e8ae04827a961942657db9a1631"),
+        // Mainnet block 1,500,000.
+        uint256S("4bf3a4e732a8ef2c8d93c996f9ffc9e8c9044ec687b13defb9b86cd33b7428e2"),
+        // Testnet genesis block.
+        uint256S("000000492c361a01ce7558a3bfb198ea3ff2f86f8b0c2e00d26135c53f4acbf7"),
+        // Hashes with runs of zero and high bits, which exercise the
+        // serialisation on reseeding.
+        uint256(),
+        uint256S("80"),
+        uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"),
+    };
+
+    const std::vector<int> mixed = {2, 502, 4, 1, 100, 65536, 3, INT_MAX, 7, 10000};
+    for (const auto& hash : hashes) {
+        // Typical draws for spawning and heart placement.
+        CheckSameDraws(hash, mixed, 500);
+        // Large moduli use up the state quickly and force many reseeds.
+        CheckSameDraws(hash, {INT_MAX}, 2000);
+        // Small moduli consume the state slowly.
+        CheckSameDraws(hash, {2}, 5000);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(range_draws)
+{
+    RandomGenerator rnd(uint256S("42"));
+    for (int i = 0; i < 1000; ++i) {
+        const int val = rnd.GetIntRnd(-5, 5);
+        BOOST_CHECK(val >= -5 && val <= 5);
+    }
+    BOOST_CHECK_EQUAL(rnd.GetIntRnd(7, 7), 7);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <game/map.h>
+#include <game/region.h>
+#include <game/state.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(gameregion_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(map_region)
+{
+    const MapRegion r(Coord(10, 5), Coord(2, 8));
+    BOOST_CHECK_EQUAL(r.min.x, 2);
+    BOOST_CHECK_EQUAL(r.min.y, 5);
+    BOOST_CHECK_EQUAL(r.max.x, 10);
+    BOOST_CHECK_EQUAL(r.max.y, 8);
+
+    BOOST_CHECK(r.Contains(Coord(2, 5)));
+    BOOST_CHECK(r.Contains(Coord(10, 8)));
+    BOOST_CHECK(!r.Contains(Coord(1, 6)));
+    BOOST_CHECK(!r.Contains(Coord(5, 9)));
+}
+
+BOOST_AUTO_TEST_CASE(map_region_clip)
+{
+    const int maxInt = std::numeric_limits<int>::max();
+    const int minInt = std::numeric_limits<int>::min();
+
+    MapRegion r(Coord(minInt, minInt), Coord(maxInt, maxInt));
+    BOOST_CHECK(r.ClipToMap());
+    BOOST_CHECK_EQUAL(r.min.x, 0);
+    BOOST_CHECK_EQUAL(r.min.y, 0);
+    BOOST_CHECK_EQUAL(r.max.x, MAP_WIDTH - 1);
+    BOOST_CHECK_EQUAL(r.max.y, MAP_HEIGHT - 1);
+
+    r = MapRegion(Coord(10, -2000000000), Coord(12, 2000000000));
+    BOOST_CHECK(r.ClipToMap());
+    BOOST_CHECK_EQUAL(r.min.x, 10);
+    BOOST_CHECK_EQUAL(r.min.y, 0);
+    BOOST_CHECK_EQUAL(r.max.x, 12);
+    BOOST_CHECK_EQUAL(r.max.y, MAP_HEIGHT - 1);
+
+    // Regions that do not overlap the map are left unchanged.
+    for (const auto& corners : std::vector<std::pair<Coord, Coord>>{
+             {Coord(-10, 0), Coord(-1, 10)},
+             {Coord(0, MAP_HEIGHT), Coord(10, maxInt)},
+             {Coord(MAP_WIDTH, 0), Coord(maxInt, maxInt)},
+             {Coord(minInt, minInt), Coord(0, -1)},
+         }) {
+        r = MapRegion(corners.first, corners.second);
+        BOOST_CHECK(!r.ClipToMap());
+        BOOST_CHECK(r.min == MapRegion(corners.first, corners.second).min);
+        BOOST_CHECK(r.max == MapRegion(corners.first, corners.second).max);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(for_each_in_region)
+{
+    std::set<Coord> coords;
+    for (int x = 0; x < 30; ++x) {
+        for (int y = 0; y < 30; ++y) {
+            coords.insert(Coord(x, y));
+        }
+    }
+
+    const MapRegion r(Coord(3, 20), Coord(7, 22));
+    std::vector<Coord> found;
+    ForEachInRegion(coords, r, [&found](const Coord& c) { found.push_back(c); });
+    BOOST_CHECK_EQUAL(found.size(), 15);
+    for (const auto& c : found) {
+        BOOST_CHECK(r.Contains(c));
+    }
+
+    std::map<Coord, unsigned> banks;
+    banks[Coord(5, 21)] = 1;
+    banks[Coord(8, 21)] = 2;
+    banks[Coord(5, 23)] = 3;
+    unsigned sum = 0;
+    ForEachInRegion(banks, r, [&sum](const std::pair<const Coord, unsigned>& b) { sum += b.second; });
+    BOOST_CHECK_EQUAL(sum, 1);
+
+    // Extreme corners are clipped to the map, so that this terminates.
+    const int maxInt = std::numeric_limits<int>::max();
+    const int minInt = std::numeric_limits<int>::min();
+    found.clear();
+    ForEachInRegion(coords, MapRegion(Coord(5, minInt), Coord(5, maxInt)), [&found](const Coord& c) { found.push_back(c); });
+    BOOST_CHECK_EQUAL(found.size(), 30);
+    found.clear();
+    ForEachInRegion(coords, MapRegion(Coord(minInt, minInt), Coord(maxInt, maxInt)), [&found](const Coord& c) { found.push_back(c); });
+    BOOST_CHECK_EQUAL(found.size(), coords.size());
+    found.clear();
+    ForEachInRegion(coords, MapRegion(Coord(0, -2000000000), Coord(0, -1)), [&found](const Coord& c) { found.push_back(c); });
+    BOOST_CHECK(found.empty());
+}
+
+BOOST_AUTO_TEST_CASE(character_grid)
+{
+    auto state = std::make_shared<GameState>(Params().GetConsensus());
+    const std::vector<Coord> positions = {
+        Coord(0, 0), Coord(15, 15), Coord(16, 16), Coord(100, 200), Coord(501, 501), Coord(250, 17),
+    };
+    PlayerState& player = state->players["domob"];
+    for (unsigned i = 0; i < positions.size(); ++i) {
+        player.characters[i].coord = positions[i];
+    }
+    state->players["other"].characters[0].coord = Coord(16, 15);
+
+    const CharacterGrid grid(state);
+    BOOST_CHECK(&grid.GetState() == state.get());
+
+    const auto query = [&grid](const Coord& a, const Coord& b) {
+        std::vector<CharacterGrid::Entry> res;
+        grid.Query(MapRegion(a, b), res);
+        std::vector<CharacterID> ids;
+        for (const auto& e : res) {
+            BOOST_CHECK(MapRegion(a, b).Contains(e.second->coord));
+            ids.push_back(e.first);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    std::vector<CharacterID> expected = {CharacterID("domob", 1), CharacterID("domob", 2), CharacterID("other", 0)};
+    BOOST_CHECK(query(Coord(15, 15), Coord(16, 16)) == expected);
+
+    expected = {CharacterID("domob", 0)};
+    BOOST_CHECK(query(Coord(-10, -10), Coord(0, 0)) == expected);
+
+    expected = {CharacterID("domob", 4)};
+    BOOST_CHECK(query(Coord(400, 400), Coord(600, 600)) == expected);
+
+    BOOST_CHECK(query(Coord(17, 17), Coord(99, 199)).empty());
+    BOOST_CHECK_EQUAL(query(Coord(0, 0), Coord(501, 501)).size(), positions.size() + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
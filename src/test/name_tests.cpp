@@ -5,7 +5,9 @@
 #include <base58.h>
 #include <coins.h>
 #include <consensus/validation.h>
+#include <game/state.h>
 #include <key_io.h>
+#include <names/index.h>
 #include <names/main.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
@@ -18,6 +20,7 @@
 #include <test/test_bitcoin.h>
 
 #include <boost/test/unit_test.hpp>
+#include <boost/xpressive/xpressive_dynamic.hpp>
 
 #include <list>
 #include <memory>
@@ -448,6 +451,247 @@ BOOST_AUTO_TEST_CASE (name_iteration)
   tester.update ("aa");
 }
 
+BOOST_AUTO_TEST_CASE (name_iteration_snapshot)
+{
+  const auto getNames = [] (CNameIterator& iter)
+    {
+      std::vector<std::string> res;
+      valtype name;
+      CNameData data;
+      for (iter.seek (valtype ()); iter.next (name, data); )
+        res.push_back (ValtypeToString (name));
+      return res;
+    };
+
+  const CScript addr = getTestAddress ();
+  const CScript updateScript
+      = CNameScript::buildNameUpdate (addr, ValtypeFromString ("dummy"),
+                                      ValtypeFromString ("abc"));
+  CNameData data;
+  data.fromScript (100, COutPoint (uint256 (), 0), CNameScript (updateScript));
+
+  uint256 dummyBlockHash;
+  *dummyBlockHash.begin () = 1;
+
+  CCoinsViewCache cache(pcoinsdbview.get ());
+  cache.SetName (ValtypeFromString ("a"), data, false);
+  cache.SetName (ValtypeFromString ("b"), data, false);
+  cache.SetBestBlock (dummyBlockHash);
+  cache.Flush ();
+  cache.SetName (ValtypeFromString ("c"), data, false);
+
+  const std::vector<std::string> expected = {"a", "b", "c"};
+  std::unique_ptr<CNameIterator> snapshot(cache.IterateNamesSnapshot ());
+  BOOST_CHECK (getNames (*snapshot) == expected);
+
+  /* Modify both the cache and the database.  */
+  cache.DeleteName (ValtypeFromString ("a"));
+  cache.DeleteName (ValtypeFromString ("c"));
+  cache.SetName (ValtypeFromString ("d"), data, false);
+  cache.Flush ();
+  cache.SetName (ValtypeFromString ("e"), data, false);
+  cache.DeleteName (ValtypeFromString ("b"));
+
+  std::unique_ptr<CNameIterator> current(cache.IterateNames ());
+  BOOST_CHECK (getNames (*current) == std::vector<std::string> ({"d", "e"}));
+  BOOST_CHECK (getNames (*snapshot) == expected);
+}
+
+/* ************************************************************************** */
+
+namespace
+{
+
+/**
+ * Construct name data with the given update height for the index tests.
+ */
+CNameData
+getIndexTestData (const unsigned height)
+{
+  const CScript addr = getTestAddress ();
+  const valtype name = ValtypeFromString ("dummy");
+  const valtype value = ValtypeFromString ("abc");
+  const CScript updateScript = CNameScript::buildNameUpdate (addr, name, value);
+  const CNameScript nameOp(updateScript);
+
+  CNameData res;
+  res.fromScript (height, COutPoint (uint256 (), 0), nameOp);
+
+  return res;
+}
+
+/**
+ * Check that the name index returns exactly the names in the view
+ * when running the filter and scan queries.
+ */
+void
+CheckNameIndex (const CNameIndex& index, const CCoinsView& view)
+{
+  const int height = index.getHeight ();
+
+  CNameIndex::EntryList expected;
+  {
+    valtype name;
+    CNameData data;
+    std::unique_ptr<CNameIterator> iter(view.IterateNames ());
+    while (iter->next (name, data))
+      expected.push_back (std::make_pair (name, data));
+  }
+
+  CNameIndex::EntryList got;
+  index.scan (valtype (), expected.size () + 1, got);
+  BOOST_CHECK (got == expected);
+
+  const std::vector<std::string> patterns =
+    {
+      "", "^p/", "^p/ab", "abc", "^p/a.*bcd", "x[yz]", "d$", "^(p|q)/",
+      "^p/abc+", "bc?d", "\\.bit$", "^q/foo", "\\x61bc", "^p/\\x61bc",
+      "\\u0070/ab", "^\\u0070/", "\\cJp/", "b(c)\\1d", "^p/a\\wc",
+      "^\\<domain", "^\\<d\\>", "abc\\>",
+    };
+  for (const int maxage : {0, 1, 5, 100})
+    for (const auto& pattern : patterns)
+      {
+        const boost::xpressive::sregex regexp
+            = boost::xpressive::sregex::compile (
+                pattern, boost::xpressive::regex_constants::single_line);
+
+        CNameIndex::EntryList candidates;
+        BOOST_CHECK_EQUAL (index.findCandidates (&pattern, maxage, candidates),
+                           height);
+
+        CNameIndex::EntryList matching;
+        for (const auto& entry : expected)
+          {
+            const int age = height - entry.second.getHeight ();
+            if (maxage != 0 && age >= maxage)
+              continue;
+            const std::string nameStr = ValtypeToString (entry.first);
+            boost::xpressive::smatch matches;
+            if (boost::xpressive::regex_search (nameStr, matches, regexp))
+              matching.push_back (entry);
+          }
+
+        CNameIndex::EntryList filtered;
+        for (const auto& entry : candidates)
+          {
+            const std::string nameStr = ValtypeToString (entry.first);
+            boost::xpressive::smatch matches;
+            if (boost::xpressive::regex_search (nameStr, matches, regexp))
+              filtered.push_back (entry);
+          }
+        BOOST_CHECK (filtered == matching);
+
+        if (pattern.empty ())
+          {
+            BOOST_CHECK (candidates == matching);
+            BOOST_CHECK (index.findCandidates (nullptr, maxage, candidates)
+                          == height);
+            BOOST_CHECK (candidates == matching);
+          }
+      }
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE (name_index_regex_literals)
+{
+  const auto check = [] (const std::string& pattern,
+                         const std::string& expectedPrefix,
+                         const std::string& expectedLiteral)
+    {
+      std::string prefix, literal;
+      ExtractRegexLiterals (pattern, prefix, literal);
+      BOOST_CHECK_EQUAL (prefix, expectedPrefix);
+      BOOST_CHECK_EQUAL (literal, expectedLiteral);
+    };
+
+  check ("", "", "");
+  check ("^", "", "");
+  check ("^id/", "id/", "id/");
+  check ("id/", "", "id/");
+  check ("^p/a.*bcd", "p/a", "p/a");
+  check ("^p/a.*bcde", "p/a", "bcde");
+  check ("^ab?c", "a", "a");
+  check ("x[abc]yz+", "", "yz");
+  check ("^[a]bc", "", "bc");
+  check ("\\.bit$", "", ".bit");
+  check ("^\\d+abc", "", "abc");
+  check ("a{2}bcd", "", "bcd");
+  check ("^(p|q)/", "", "");
+  check ("abc|def", "", "");
+  check ("[abc", "", "");
+  check ("^ab\\dcd", "ab", "ab");
+  check ("\\w+xyz", "", "xyz");
+  check ("^a\\n\\tbc", "a", "bc");
+  check ("^\\<abc", "", "abc");
+  check ("^ab\\>cde", "ab", "cde");
+  check ("\\<p/abc\\>", "", "p/abc");
+
+  /* Escapes that continue after the escaped character.  */
+  check ("\\x41bc", "", "");
+  check ("^p/\\x41bc", "", "");
+  check ("\\u0041", "", "");
+  check ("\\cAbc", "", "");
+  check ("(a)\\1bc", "", "");
+  check ("abc\\0de", "", "");
+}
+
+BOOST_AUTO_TEST_CASE (name_index)
+{
+  CCoinsViewCache view(pcoinsdbview.get ());
+
+  const std::vector<std::pair<std::string, unsigned>> initial =
+    {
+      {"", 1}, {"a", 2}, {"p/abc", 10}, {"p/abd", 98}, {"p/abcd", 99},
+      {"p/abccd", 100}, {"p/xyz", 97}, {"q/foo", 50}, {"q/abc", 96},
+      {"domain.bit", 100}, {"d", 100}, {"x\np/abc", 100},
+    };
+  for (const auto& entry : initial)
+    view.SetName (ValtypeFromString (entry.first),
+                  getIndexTestData (entry.second), false);
+
+  CNameIndex index;
+  BOOST_CHECK_EQUAL (index.getHeight (), -1);
+  index.build (view, 100);
+  BOOST_CHECK_EQUAL (index.getHeight (), 100);
+  BOOST_CHECK_EQUAL (index.size (), initial.size ());
+  CheckNameIndex (index, view);
+
+  CNameIndex::EntryList entries;
+  index.scan (ValtypeFromString ("p/abc"), 2, entries);
+  BOOST_CHECK_EQUAL (entries.size (), 2u);
+  BOOST_CHECK (entries[0].first == ValtypeFromString ("p/abc"));
+  BOOST_CHECK (entries[1].first == ValtypeFromString ("p/abd"));
+
+  /* Apply a "block" that adds, updates and deletes names.  */
+  {
+    CCoinsViewCache block(&view);
+    block.SetName (ValtypeFromString ("p/new"), getIndexTestData (101), false);
+    block.SetName (ValtypeFromString ("p/abc"), getIndexTestData (101), false);
+    block.DeleteName (ValtypeFromString ("p/xyz"));
+    block.DeleteName (ValtypeFromString ("q/abc"));
+
+    index.apply (block.GetNameCache (), 101);
+    block.Flush ();
+  }
+  BOOST_CHECK_EQUAL (index.getHeight (), 101);
+  BOOST_CHECK_EQUAL (index.size (), initial.size () - 1);
+  CheckNameIndex (index, view);
+
+  /* Undo part of it again, as a disconnected block would.  */
+  {
+    CCoinsViewCache block(&view);
+    block.DeleteName (ValtypeFromString ("p/new"));
+    block.SetName (ValtypeFromString ("p/xyz"), getIndexTestData (97), false);
+
+    index.apply (block.GetNameCache (), 100);
+    block.Flush ();
+  }
+  BOOST_CHECK_EQUAL (index.getHeight (), 100);
+  CheckNameIndex (index, view);
+}
+
 /* ************************************************************************** */
 
 /**
@@ -774,6 +1018,89 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (undo.vnameundo.empty ());
 }
 
+BOOST_AUTO_TEST_CASE (name_history_entries)
+{
+  fNameHistory = true;
+
+  const valtype name = ValtypeFromString ("history-test-name");
+  const CScript addr = getTestAddress ();
+  std::vector<CNameData> updates;
+  for (unsigned i = 0; i < 5; ++i)
+    {
+      const valtype value = ValtypeFromString ("value " + std::to_string (i));
+      const CScript scr = CNameScript::buildNameUpdate (addr, name, value);
+      CNameData data;
+      data.fromScript (100 + i, COutPoint (uint256 (), i), CNameScript (scr));
+      updates.push_back (data);
+    }
+
+  uint256 dummyBlockHash;
+  *dummyBlockHash.begin () = 1;
+
+  /* Apply the updates in two "blocks" that are flushed to the database,
+     so that the history is split between database and cache.  */
+  CCoinsViewCache view(pcoinsdbview.get ());
+  view.SetBestBlock (dummyBlockHash);
+  for (unsigned i = 0; i < 3; ++i)
+    view.SetName (name, updates[i], false);
+  BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), 2u);
+  view.Flush ();
+  BOOST_CHECK_EQUAL (pcoinsdbview->GetNameHistorySize (name), 2u);
+
+  {
+    CCoinsViewCache block(&view);
+    block.SetBestBlock (dummyBlockHash);
+    for (unsigned i = 3; i < 5; ++i)
+      block.SetName (name, updates[i], false);
+    block.Flush ();
+  }
+  BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), 4u);
+  BOOST_CHECK_EQUAL (pcoinsdbview->GetNameHistorySize (name), 2u);
+  view.Flush ();
+
+  CNameHistory history;
+  BOOST_CHECK (pcoinsdbview->GetNameHistory (name, history));
+  BOOST_CHECK (history.getData ()
+                == std::vector<CNameData> (updates.begin (),
+                                           updates.begin () + 4));
+  CNameData entry;
+  BOOST_CHECK (pcoinsdbview->GetNameHistoryEntry (name, 2, entry));
+  BOOST_CHECK (entry == updates[2]);
+  BOOST_CHECK (!pcoinsdbview->GetNameHistoryEntry (name, 4, entry));
+
+  /* Undo two updates and push a different one.  */
+  {
+    CCoinsViewCache block(&view);
+    block.SetBestBlock (dummyBlockHash);
+    block.SetName (name, updates[3], true);
+    block.SetName (name, updates[2], true);
+    BOOST_CHECK_EQUAL (block.GetNameHistorySize (name), 2u);
+    block.SetName (name, updates[4], false);
+    BOOST_CHECK_EQUAL (block.GetNameHistorySize (name), 3u);
+    BOOST_CHECK (block.GetNameHistoryEntry (name, 2, entry));
+    BOOST_CHECK (entry == updates[2]);
+    block.Flush ();
+  }
+  view.Flush ();
+
+  BOOST_CHECK_EQUAL (pcoinsdbview->GetNameHistorySize (name), 3u);
+  BOOST_CHECK (pcoinsdbview->GetNameHistoryEntry (name, 2, entry));
+  BOOST_CHECK (entry == updates[2]);
+  BOOST_CHECK (!pcoinsdbview->GetNameHistoryEntry (name, 3, entry));
+
+  /* Undo everything, which should remove the history completely.  */
+  view.SetName (name, updates[2], true);
+  view.SetName (name, updates[1], true);
+  view.SetName (name, updates[0], true);
+  view.DeleteName (name);
+  view.Flush ();
+  BOOST_CHECK_EQUAL (pcoinsdbview->GetNameHistorySize (name), 0u);
+  BOOST_CHECK (!pcoinsdbview->GetNameHistoryEntry (name, 0, entry));
+  BOOST_CHECK (!pcoinsdbview->GetNameHistory (name, history));
+
+  fNameHistory = false;
+}
+
 /* ************************************************************************** */
 
 BOOST_AUTO_TEST_CASE (name_mempool)
@@ -962,6 +1289,234 @@ BOOST_AUTO_TEST_CASE (name_mempool)
   BOOST_CHECK (mempool.mapTx.empty ());
 }
 
+BOOST_AUTO_TEST_CASE (name_changes_consistency)
+{
+  const valtype name1 = ValtypeFromString ("player 1");
+  const valtype name2 = ValtypeFromString ("player 2");
+  const CScript addr = getTestAddress ();
+  const CScript upd1
+    = CNameScript::buildNameUpdate (addr, name1, ValtypeFromString ("{}"));
+  const CScript upd2
+    = CNameScript::buildNameUpdate (addr, name2, ValtypeFromString ("{}"));
+
+  CCoinsView dummyView;
+  CCoinsViewCache base(&dummyView);
+  const COutPoint out1 = addTestCoin (upd1, 100, base);
+  CNameData data1;
+  data1.fromScript (100, out1, CNameScript (upd1));
+  base.SetName (name1, data1, false);
+
+  const Consensus::Params& params = Params ().GetConsensus ();
+  GameState oldState(params);
+  oldState.players["player 1"].lockedCoins = 1000 * COIN;
+
+  /* A block registering the second player.  */
+  {
+    CCoinsViewCache view(&base);
+    const COutPoint out2 = addTestCoin (upd2, 101, view);
+    CNameData data2;
+    data2.fromScript (101, out2, CNameScript (upd2));
+    view.SetName (name2, data2, false);
+
+    GameState newState(params);
+    newState.players = oldState.players;
+    BOOST_CHECK (!ValidateNameChanges (view, newState, PlayerSet ()));
+    newState.players["player 2"].lockedCoins = 999 * COIN;
+    BOOST_CHECK (!ValidateNameChanges (view, newState, PlayerSet ()));
+    newState.players["player 2"].lockedCoins = 1000 * COIN;
+    BOOST_CHECK (ValidateNameChanges (view, newState, PlayerSet ()));
+
+    /* The first player is not touched by the block, so the step must
+       not have changed it.  */
+    const PlayerSet changed = {"player 1"};
+    BOOST_CHECK (!ValidateNameChanges (view, newState, changed));
+    newState.players.erase ("player 1");
+    BOOST_CHECK (!ValidateNameChanges (view, newState, changed));
+  }
+
+  /* A block killing the first player.  */
+  {
+    CCoinsViewCache view(&base);
+    view.SpendCoin (out1);
+    data1.setDead (102, uint256 ());
+    view.SetName (name1, data1, false);
+
+    const PlayerSet killed = {"player 1"};
+    GameState newState(params);
+    newState.players = oldState.players;
+    BOOST_CHECK (!ValidateNameChanges (view, newState, killed));
+    newState.players.erase ("player 1");
+    BOOST_CHECK (ValidateNameChanges (view, newState, killed));
+  }
+
+  /* A name that is alive, but whose output is missing.  */
+  {
+    CCoinsViewCache view(&base);
+    view.SpendCoin (out1);
+    data1.fromScript (102, out1, CNameScript (upd1));
+    view.SetName (name1, data1, false);
+    BOOST_CHECK (!ValidateNameChanges (view, oldState, PlayerSet ()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE (name_mempool_fast_path)
+{
+  LOCK(mempool.cs);
+  mempool.clear ();
+
+  const valtype name = ValtypeFromString ("player");
+  const valtype nameReg = ValtypeFromString ("name-reg");
+  const CScript addr = getTestAddress ();
+  const CScript upd
+    = CNameScript::buildNameUpdate (addr, name, ValtypeFromString ("move"));
+  const CScript first1
+    = CNameScript::buildNameFirstupdate (addr, nameReg,
+                                         ValtypeFromString ("value"),
+                                         valtype (20, 'a'));
+  const CScript first2
+    = CNameScript::buildNameFirstupdate (addr, nameReg,
+                                         ValtypeFromString ("value"),
+                                         valtype (20, 'b'));
+
+  uint256 tip1, tip2;
+  *tip1.begin () = 1;
+  *tip2.begin () = 2;
+  const COutPoint out1(tip1, 0);
+  const COutPoint out2(tip2, 0);
+
+  CCoinsViewCache view(pcoinsTip.get ());
+  view.SetBestBlock (tip1);
+
+  CMutableTransaction txUpd;
+  txUpd.SetNamecoin ();
+  txUpd.vin.push_back (CTxIn (out1));
+  txUpd.vout.push_back (CTxOut (COIN, upd));
+
+  /* The name does not exist yet.  */
+  BOOST_CHECK (!mempool.checkNameUpdateFast (txUpd, view));
+
+  CNameData data;
+  data.fromScript (100, out1, CNameScript (upd));
+  view.SetName (name, data, false);
+  view.SetBestBlock (tip2);
+  BOOST_CHECK (mempool.checkNameUpdateFast (txUpd, view));
+
+  /* The cached data is used as long as the tip stays the same.  */
+  data.fromScript (101, out2, CNameScript (upd));
+  view.SetName (name, data, false);
+  BOOST_CHECK (mempool.checkNameUpdateFast (txUpd, view));
+
+  /* With a new tip, the move spending the old name output is stale.  */
+  view.SetBestBlock (tip1);
+  BOOST_CHECK (!mempool.checkNameUpdateFast (txUpd, view));
+  txUpd.vin[0].prevout = out2;
+  BOOST_CHECK (mempool.checkNameUpdateFast (txUpd, view));
+
+  data.setDead (102, tip2);
+  view.SetName (name, data, false);
+  view.SetBestBlock (tip2);
+  BOOST_CHECK (!mempool.checkNameUpdateFast (txUpd, view));
+
+  /* Non-update transactions are not affected.  */
+  CMutableTransaction txReg1;
+  txReg1.SetNamecoin ();
+  txReg1.vout.push_back (CTxOut (COIN, first1));
+  BOOST_CHECK (mempool.checkNameUpdateFast (txReg1, view));
+
+  /* Conflicting registrations are removed when a block is connected.  */
+  CMutableTransaction txReg2;
+  txReg2.SetNamecoin ();
+  txReg2.vout.push_back (CTxOut (COIN, first2));
+
+  const LockPoints lp;
+  const CTxMemPoolEntry entryReg(MakeTransactionRef (txReg1), 0, 0, 100,
+                                 false, 1, lp);
+  mempool.addUnchecked (entryReg.GetTx ().GetHash (), entryReg);
+  BOOST_CHECK (mempool.registersName (nameReg));
+
+  {
+    CNameConflictTracker tracker(mempool);
+    const std::vector<CTransactionRef> vtx = {MakeTransactionRef (txReg2)};
+    mempool.removeForBlock (vtx, 100);
+    BOOST_CHECK (tracker.GetNameConflicts ()->size () == 1);
+    BOOST_CHECK (tracker.GetNameConflicts ()->front ()->GetHash ()
+                  == txReg1.GetHash ());
+  }
+  BOOST_CHECK (!mempool.registersName (nameReg));
+  BOOST_CHECK (mempool.mapTx.empty ());
+}
+
+BOOST_AUTO_TEST_CASE (name_mempool_replacement)
+{
+  LOCK(mempool.cs);
+  mempool.clear ();
+
+  const valtype name = ValtypeFromString ("player");
+  const valtype other = ValtypeFromString ("other");
+  const CScript addr = getTestAddress ();
+  const CScript upd1
+    = CNameScript::buildNameUpdate (addr, name, ValtypeFromString ("move 1"));
+  const CScript upd2
+    = CNameScript::buildNameUpdate (addr, name, ValtypeFromString ("move 2"));
+  const CScript updOther
+    = CNameScript::buildNameUpdate (addr, other, ValtypeFromString ("move"));
+
+  uint256 prev1, prev2;
+  *prev1.begin () = 1;
+  *prev2.begin () = 2;
+
+  CMutableTransaction txUpd1;
+  txUpd1.SetNamecoin ();
+  txUpd1.vin.push_back (CTxIn (COutPoint (prev1, 0)));
+  txUpd1.vout.push_back (CTxOut (COIN, upd1));
+
+  /* The new move spends the same name output.  */
+  CMutableTransaction txUpd2;
+  txUpd2.SetNamecoin ();
+  txUpd2.vin.push_back (CTxIn (COutPoint (prev1, 0)));
+  txUpd2.vout.push_back (CTxOut (COIN, upd2));
+
+  /* This one updates the same name but does not conflict.  */
+  CMutableTransaction txUpd3;
+  txUpd3.SetNamecoin ();
+  txUpd3.vin.push_back (CTxIn (COutPoint (prev2, 0)));
+  txUpd3.vout.push_back (CTxOut (COIN, upd2));
+
+  CMutableTransaction txOther;
+  txOther.SetNamecoin ();
+  txOther.vin.push_back (CTxIn (COutPoint (prev1, 0)));
+  txOther.vout.push_back (CTxOut (COIN, updOther));
+
+  BOOST_CHECK (IsNameUpdateReplacement (txUpd2, txUpd1));
+  BOOST_CHECK (IsNameUpdateReplacement (txUpd3, txUpd1));
+  BOOST_CHECK (!IsNameUpdateReplacement (txOther, txUpd1));
+  BOOST_CHECK (!IsNameUpdateReplacement (CMutableTransaction (), txUpd1));
+
+  const LockPoints lp;
+  const CTxMemPoolEntry entryUpd(MakeTransactionRef (txUpd1), 0, 0, 100,
+                                 false, 1, lp);
+  mempool.addUnchecked (entryUpd.GetTx ().GetHash (), entryUpd);
+  BOOST_CHECK (mempool.updatesName (name));
+
+  BOOST_CHECK (mempool.checkNameOps (txUpd2));
+  BOOST_CHECK (!mempool.checkNameOps (txUpd3));
+  BOOST_CHECK (mempool.checkNameOps (txOther));
+
+  /* Replace the pending move in the way ATMP does it.  */
+  CTxMemPool::setEntries toRemove;
+  toRemove.insert (mempool.mapTx.find (txUpd1.GetHash ()));
+  mempool.RemoveStaged (toRemove, false, MemPoolRemovalReason::REPLACED);
+  BOOST_CHECK (!mempool.updatesName (name));
+
+  const CTxMemPoolEntry entryUpd2(MakeTransactionRef (txUpd2), 0, 0, 100,
+                                  false, 1, lp);
+  mempool.addUnchecked (entryUpd2.GetTx ().GetHash (), entryUpd2);
+  BOOST_CHECK (mempool.getTxForName (name) == txUpd2.GetHash ());
+  BOOST_CHECK (mempool.checkNameOps (txUpd1));
+
+  mempool.clear ();
+}
+
 /* ************************************************************************** */
 
 BOOST_AUTO_TEST_SUITE_END ()
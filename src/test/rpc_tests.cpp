@@ -336,4 +336,53 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_json_stream_writer)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.pushKV("quote\"d", "line\nbreak");
+    inner.pushKV("empty", UniValue(UniValue::VARR));
+    inner.pushKV("flag", UniValue(false));
+    UniValue val(UniValue::VARR);
+    val.push_back(inner);
+    val.push_back(NullUniValue);
+    val.push_back(-1.5);
+    val.push_back(UniValue(UniValue::VOBJ));
+    for (int i = 0; i < 10000; ++i)
+        val.push_back(std::string(10, 'a' + i % 26));
+
+    std::string out;
+    size_t chunks = 0;
+    JSONStreamWriter writer([&out, &chunks](const char* data, size_t len) {
+        out.append(data, len);
+        ++chunks;
+    });
+    writer.Write(val);
+    writer.Flush();
+    BOOST_CHECK_EQUAL(out, val.write());
+    BOOST_CHECK(chunks > 1);
+
+    // The reply envelope is the same as for JSONRPCReply.
+    const UniValue id("some id");
+    for (const auto& error : {NullUniValue, JSONRPCError(RPC_MISC_ERROR, "failed")}) {
+        out.clear();
+        JSONRPCWriteReply(writer, inner, error, id);
+        writer.Flush();
+        BOOST_CHECK_EQUAL(out, JSONRPCReply(inner, error, id));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rpc_parallel_batch_flag)
+{
+    // Only commands that merely query the node's state run concurrently
+    // within a batch.
+    for (const std::string name : {"getblockcount", "getblock", "gettxout", "name_show", "game_getstate"}) {
+        BOOST_REQUIRE(tableRPC[name] != nullptr);
+        BOOST_CHECK(tableRPC[name]->parallelBatch);
+    }
+    for (const std::string name : {"stop", "setban", "generatetoaddress", "game_previewstep"}) {
+        BOOST_REQUIRE(tableRPC[name] != nullptr);
+        BOOST_CHECK(!tableRPC[name]->parallelBatch);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
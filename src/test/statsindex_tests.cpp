@@ -0,0 +1,87 @@
+// Copyright (c) 2018 Daniel Kraft
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <game/db.h>
+#include <game/state.h>
+#include <index/statsindex.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(statsindex_tests)
+
+static void CheckStats(const StatsIndex& index, const CBlockIndex* pindex)
+{
+    CBlock block;
+    std::vector<CTransactionRef> vGameTx;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, vGameTx, pindex, Params().GetConsensus()));
+    GameState state(Params().GetConsensus());
+    BOOST_REQUIRE(pgameDb->get(pindex->GetBlockHash(), state));
+
+    CBlockStats expected;
+    ComputeBlockStats(block, vGameTx, state, expected);
+
+    CBlockStats stats;
+    BOOST_REQUIRE(index.LookupStats(pindex, stats));
+    BOOST_CHECK(stats.hashBlock == pindex->GetBlockHash());
+    BOOST_CHECK_EQUAL(stats.nTime, expected.nTime);
+    BOOST_CHECK_EQUAL(stats.nSize, expected.nSize);
+    BOOST_CHECK_EQUAL(stats.nCurrencyTx, expected.nCurrencyTx);
+    BOOST_CHECK_EQUAL(stats.nNameTx, expected.nNameTx);
+    BOOST_CHECK_EQUAL(stats.nGameTx, expected.nGameTx);
+    BOOST_CHECK_EQUAL(stats.nPlayers, expected.nPlayers);
+    BOOST_CHECK_EQUAL(stats.nHunters, expected.nHunters);
+}
+
+BOOST_FIXTURE_TEST_CASE(statsindex_initial_sync, TestChain100Setup)
+{
+    StatsIndex statsindex(1 << 20, true);
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started.
+    BOOST_CHECK(!statsindex.BlockUntilSyncedToCurrentChain());
+
+    statsindex.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!statsindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        for (int h = 0; h <= chainActive.Height(); ++h) {
+            blocks.push_back(chainActive[h]);
+        }
+    }
+    for (const auto* pindex : blocks) {
+        CheckStats(statsindex, pindex);
+    }
+
+    // Check that new blocks make it into the index.
+    for (int i = 0; i < 10; i++) {
+        CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+        std::vector<CMutableTransaction> no_txns;
+        const CBlock& block = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+
+        BOOST_CHECK(statsindex.BlockUntilSyncedToCurrentChain());
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = LookupBlockIndex(block.GetHash());
+        }
+        BOOST_REQUIRE(pindex != nullptr);
+        CheckStats(statsindex, pindex);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -185,4 +185,27 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+BOOST_FIXTURE_TEST_CASE(game_tx_storage, TestChain100Setup)
+{
+    LOCK(cs_main);
+    for (int h = 1; h <= chainActive.Height(); ++h) {
+        CBlockIndex* pindex = chainActive[h];
+        BOOST_CHECK(pindex->nStatus & BLOCK_HAVE_GAMETX);
+
+        std::vector<CTransactionRef> vGameTx;
+        BOOST_CHECK(ReadGameTxFromDisk(vGameTx, pindex));
+
+        // Without the flag, the game tx are read from the undo data instead.
+        std::vector<CTransactionRef> vGameTxUndo;
+        pindex->nStatus &= ~BLOCK_HAVE_GAMETX;
+        BOOST_CHECK(ReadGameTxFromDisk(vGameTxUndo, pindex));
+        pindex->nStatus |= BLOCK_HAVE_GAMETX;
+
+        BOOST_REQUIRE_EQUAL(vGameTx.size(), vGameTxUndo.size());
+        for (unsigned i = 0; i < vGameTx.size(); ++i) {
+            BOOST_CHECK(*vGameTx[i] == *vGameTxUndo[i]);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
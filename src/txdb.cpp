@@ -26,11 +26,14 @@ static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
-static const char DB_TXINDEX_BLOCK = 'T';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_GAME_TX = 'g';
 
 static const char DB_NAME = 'n';
+/* Legacy format of the name history, storing the full stack per name.  */
 static const char DB_NAME_HISTORY = 'h';
+static const char DB_NAME_HISTORY_SIZE = 'k';
+static const char DB_NAME_HISTORY_ENTRY = 'e';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -60,6 +63,37 @@ struct CoinEntry {
     }
 };
 
+/**
+ * Database key for a single entry of a name's history.  The index is
+ * serialised in big-endian order, so that the entries of a name are
+ * ordered by their position in the history stack.
+ */
+struct NameHistoryEntryKey {
+    char key;
+    valtype name;
+    uint32_t index;
+
+    NameHistoryEntryKey() : key(DB_NAME_HISTORY_ENTRY), index(0) {}
+    NameHistoryEntryKey(const valtype& n, uint32_t i) : key(DB_NAME_HISTORY_ENTRY), name(n), index(i) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s << name;
+        const uint32_t be = htobe32(index);
+        s.write(reinterpret_cast<const char*>(&be), sizeof(be));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> name;
+        uint32_t be;
+        s.read(reinterpret_cast<char*>(&be), sizeof(be));
+        index = be32toh(be);
+    }
+};
+
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
@@ -93,9 +127,17 @@ bool CCoinsViewDB::GetName(const valtype &name, CNameData& data) const {
     return db.Read(std::make_pair(DB_NAME, name), data);
 }
 
-bool CCoinsViewDB::GetNameHistory(const valtype &name, CNameHistory& data) const {
+unsigned CCoinsViewDB::GetNameHistorySize(const valtype &name) const {
+    assert (fNameHistory);
+    uint32_t size;
+    if (!db.Read(std::make_pair(DB_NAME_HISTORY_SIZE, name), size))
+        return 0;
+    return size;
+}
+
+bool CCoinsViewDB::GetNameHistoryEntry(const valtype &name, unsigned index, CNameData& data) const {
     assert (fNameHistory);
-    return db.Read(std::make_pair(DB_NAME_HISTORY, name), data);
+    return db.Read(NameHistoryEntryKey(name, index), data);
 }
 
 class CDbNameIterator : public CNameIterator
@@ -156,6 +198,14 @@ CNameIterator* CCoinsViewDB::IterateNames() const {
     return new CDbNameIterator(db);
 }
 
+CNameIterator* CCoinsViewDB::IterateNamesSnapshot() const {
+    /* A LevelDB iterator reads from an implicit snapshot of the database
+       that is taken when the iterator is created.  Since CDbNameIterator
+       keeps using the same LevelDB iterator also when seeking, it is not
+       affected by later writes (e. g., flushes from connected blocks).  */
+    return IterateNames();
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) {
     CDBBatch batch(db);
     size_t count = 0;
@@ -334,7 +384,8 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
 
     std::set<valtype> namesTotal;
     std::set<valtype> namesInDB;
-    std::set<valtype> namesWithHistory;
+    std::map<valtype, unsigned> namesWithHistory;
+    std::map<valtype, unsigned> historyEntries;
     std::map<valtype, CAmount> namesInUTXO;
 
     for (; pcursor->Valid(); pcursor->Next())
@@ -391,17 +442,42 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
         }
 
         case DB_NAME_HISTORY:
+            return error("%s : name history in the legacy format", __func__);
+
+        case DB_NAME_HISTORY_SIZE:
         {
             std::pair<char, valtype> key;
-            if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY)
-                return error("%s : failed to read DB_NAME_HISTORY key",
+            if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY_SIZE)
+                return error("%s : failed to read DB_NAME_HISTORY_SIZE key",
                              __func__);
             const valtype& name = key.second;
 
+            uint32_t size;
+            if (!pcursor->GetValue(size))
+                return error("%s : failed to read name history size",
+                             __func__);
+
             if (namesWithHistory.count(name) > 0)
                 return error("%s : name %s has duplicate history",
                              __func__, ValtypeToString(name).c_str());
-            namesWithHistory.insert(name);
+            namesWithHistory.insert(std::make_pair(name, size));
+            break;
+        }
+
+        case DB_NAME_HISTORY_ENTRY:
+        {
+            NameHistoryEntryKey key;
+            if (!pcursor->GetKey(key) || key.key != DB_NAME_HISTORY_ENTRY)
+                return error("%s : failed to read DB_NAME_HISTORY_ENTRY key",
+                             __func__);
+
+            /* Entries of a name are ordered by index, so that we can
+               verify that they form a contiguous stack.  */
+            unsigned& count = historyEntries[key.name];
+            if (key.index != count)
+                return error("%s : history of name %s is not contiguous",
+                             __func__, ValtypeToString(key.name).c_str());
+            ++count;
             break;
         }
 
@@ -442,11 +518,20 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
 
     if (fNameHistory)
     {
-        for (const auto& name : namesWithHistory)
-            if (namesTotal.count(name) == 0)
+        for (const auto& entry : namesWithHistory)
+            if (namesTotal.count(entry.first) == 0)
                 return error("%s : history entry for name '%s' not in main DB",
-                             __func__, ValtypeToString(name).c_str());
-    } else if (!namesWithHistory.empty ())
+                             __func__, ValtypeToString(entry.first).c_str());
+        for (const auto& entry : historyEntries)
+        {
+            const auto mit = namesWithHistory.find(entry.first);
+            if (mit == namesWithHistory.end() || mit->second != entry.second)
+                return error("%s : history size of name '%s' is wrong",
+                             __func__, ValtypeToString(entry.first).c_str());
+        }
+        if (historyEntries.size() != namesWithHistory.size())
+            return error("%s : name history size without entries", __func__);
+    } else if (!namesWithHistory.empty () || !historyEntries.empty ())
         return error("%s : name_history entries in DB, but"
                      " -namehistory not set", __func__);
 
@@ -469,12 +554,19 @@ CNameCache::writeBatch (CDBBatch& batch) const
     batch.Erase (std::make_pair (DB_NAME, *i));
 
   assert (fNameHistory || history.empty ());
-  for (std::map<valtype, CNameHistory>::const_iterator i = history.begin ();
-       i != history.end (); ++i)
-    if (i->second.empty ())
-      batch.Erase (std::make_pair (DB_NAME_HISTORY, i->first));
-    else
-      batch.Write (std::make_pair (DB_NAME_HISTORY, i->first), i->second);
+  for (const auto& entry : history)
+    {
+      for (const unsigned index : entry.second.erased)
+        batch.Erase (NameHistoryEntryKey (entry.first, index));
+      for (const auto& e : entry.second.entries)
+        batch.Write (NameHistoryEntryKey (entry.first, e.first), e.second);
+
+      const auto sizeKey = std::make_pair (DB_NAME_HISTORY_SIZE, entry.first);
+      if (entry.second.size == 0)
+        batch.Erase (sizeKey);
+      else
+        batch.Write (sizeKey, static_cast<uint32_t> (entry.second.size));
+    }
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
@@ -488,6 +580,14 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadGameTx(const uint256 &hash, std::vector<CTransactionRef> &vGameTx) {
+    return Read(std::make_pair(DB_GAME_TX, hash), vGameTx);
+}
+
+bool CBlockTreeDB::WriteGameTx(const uint256 &hash, const std::vector<CTransactionRef> &vGameTx) {
+    return Write(std::make_pair(DB_GAME_TX, hash), vGameTx);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -603,11 +703,63 @@ public:
 
 }
 
+/** Convert name histories stored as a single record per name to individual
+ * entries plus their count.
+ */
+bool CCoinsViewDB::UpgradeNameHistory() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_NAME_HISTORY);
+
+    std::pair<char, valtype> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+        return true;
+    }
+
+    LogPrintf("Upgrading name history database...\n");
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    size_t count = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+            break;
+        }
+
+        CNameHistory history;
+        if (!pcursor->GetValue(history)) {
+            return error("%s: cannot parse name history record", __func__);
+        }
+        const std::vector<CNameData>& entries = history.getData();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            batch.Write(NameHistoryEntryKey(key.second, i), entries[i]);
+        }
+        batch.Write(std::make_pair(DB_NAME_HISTORY_SIZE, key.second), static_cast<uint32_t>(entries.size()));
+        batch.Erase(key);
+        ++count;
+
+        if (batch.SizeEstimate() > batch_size) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    db.WriteBatch(batch);
+    LogPrintf("Upgraded the history of %u names [%s].\n", count, ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested();
+}
+
 /** Upgrade the database from older formats.
  *
  * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout.
  */
 bool CCoinsViewDB::Upgrade() {
+    if (!UpgradeNameHistory()) {
+        return false;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
     pcursor->Seek(std::make_pair(DB_COINS, uint256()));
     if (!pcursor->Valid()) {
@@ -672,173 +824,3 @@ bool CCoinsViewDB::Upgrade() {
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
     return !ShutdownRequested();
 }
-
-TxIndexDB::TxIndexDB(size_t n_cache_size, bool f_memory, bool f_wipe) :
-    CDBWrapper(GetDataDir() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe)
-{}
-
-bool TxIndexDB::ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const
-{
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
-}
-
-bool TxIndexDB::WriteTxs(const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos)
-{
-    CDBBatch batch(*this);
-    for (const auto& tuple : v_pos) {
-        batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
-    }
-    return WriteBatch(batch);
-}
-
-bool TxIndexDB::ReadBestBlock(CBlockLocator& locator) const
-{
-    bool success = Read(DB_BEST_BLOCK, locator);
-    if (!success) {
-        locator.SetNull();
-    }
-    return success;
-}
-
-bool TxIndexDB::WriteBestBlock(const CBlockLocator& locator)
-{
-    return Write(DB_BEST_BLOCK, locator);
-}
-
-/*
- * Safely persist a transfer of data from the old txindex database to the new one, and compact the
- * range of keys updated. This is used internally by MigrateData.
- */
-static void WriteTxIndexMigrationBatches(TxIndexDB& newdb, CBlockTreeDB& olddb,
-                                         CDBBatch& batch_newdb, CDBBatch& batch_olddb,
-                                         const std::pair<unsigned char, uint256>& begin_key,
-                                         const std::pair<unsigned char, uint256>& end_key)
-{
-    // Sync new DB changes to disk before deleting from old DB.
-    newdb.WriteBatch(batch_newdb, /*fSync=*/ true);
-    olddb.WriteBatch(batch_olddb);
-    olddb.CompactRange(begin_key, end_key);
-
-    batch_newdb.Clear();
-    batch_olddb.Clear();
-}
-
-bool TxIndexDB::MigrateData(CBlockTreeDB& block_tree_db, const CBlockLocator& best_locator)
-{
-    // The prior implementation of txindex was always in sync with block index
-    // and presence was indicated with a boolean DB flag. If the flag is set,
-    // this means the txindex from a previous version is valid and in sync with
-    // the chain tip. The first step of the migration is to unset the flag and
-    // write the chain hash to a separate key, DB_TXINDEX_BLOCK. After that, the
-    // index entries are copied over in batches to the new database. Finally,
-    // DB_TXINDEX_BLOCK is erased from the old database and the block hash is
-    // written to the new database.
-    //
-    // Unsetting the boolean flag ensures that if the node is downgraded to a
-    // previous version, it will not see a corrupted, partially migrated index
-    // -- it will see that the txindex is disabled. When the node is upgraded
-    // again, the migration will pick up where it left off and sync to the block
-    // with hash DB_TXINDEX_BLOCK.
-    bool f_legacy_flag = false;
-    block_tree_db.ReadFlag("txindex", f_legacy_flag);
-    if (f_legacy_flag) {
-        if (!block_tree_db.Write(DB_TXINDEX_BLOCK, best_locator)) {
-            return error("%s: cannot write block indicator", __func__);
-        }
-        if (!block_tree_db.WriteFlag("txindex", false)) {
-            return error("%s: cannot write block index db flag", __func__);
-        }
-    }
-
-    CBlockLocator locator;
-    if (!block_tree_db.Read(DB_TXINDEX_BLOCK, locator)) {
-        return true;
-    }
-
-    int64_t count = 0;
-    LogPrintf("Upgrading txindex database... [0%%]\n");
-    uiInterface.ShowProgress(_("Upgrading txindex database"), 0, true);
-    int report_done = 0;
-    const size_t batch_size = 1 << 24; // 16 MiB
-
-    CDBBatch batch_newdb(*this);
-    CDBBatch batch_olddb(block_tree_db);
-
-    std::pair<unsigned char, uint256> key;
-    std::pair<unsigned char, uint256> begin_key{DB_TXINDEX, uint256()};
-    std::pair<unsigned char, uint256> prev_key = begin_key;
-
-    bool interrupted = false;
-    std::unique_ptr<CDBIterator> cursor(block_tree_db.NewIterator());
-    for (cursor->Seek(begin_key); cursor->Valid(); cursor->Next()) {
-        boost::this_thread::interruption_point();
-        if (ShutdownRequested()) {
-            interrupted = true;
-            break;
-        }
-
-        if (!cursor->GetKey(key)) {
-            return error("%s: cannot get key from valid cursor", __func__);
-        }
-        if (key.first != DB_TXINDEX) {
-            break;
-        }
-
-        // Log progress every 10%.
-        if (++count % 256 == 0) {
-            // Since txids are uniformly random and traversed in increasing order, the high 16 bits
-            // of the hash can be used to estimate the current progress.
-            const uint256& txid = key.second;
-            uint32_t high_nibble =
-                (static_cast<uint32_t>(*(txid.begin() + 0)) << 8) +
-                (static_cast<uint32_t>(*(txid.begin() + 1)) << 0);
-            int percentage_done = (int)(high_nibble * 100.0 / 65536.0 + 0.5);
-
-            uiInterface.ShowProgress(_("Upgrading txindex database"), percentage_done, true);
-            if (report_done < percentage_done/10) {
-                LogPrintf("Upgrading txindex database... [%d%%]\n", percentage_done);
-                report_done = percentage_done/10;
-            }
-        }
-
-        CDiskTxPos value;
-        if (!cursor->GetValue(value)) {
-            return error("%s: cannot parse txindex record", __func__);
-        }
-        batch_newdb.Write(key, value);
-        batch_olddb.Erase(key);
-
-        if (batch_newdb.SizeEstimate() > batch_size || batch_olddb.SizeEstimate() > batch_size) {
-            // NOTE: it's OK to delete the key pointed at by the current DB cursor while iterating
-            // because LevelDB iterators are guaranteed to provide a consistent view of the
-            // underlying data, like a lightweight snapshot.
-            WriteTxIndexMigrationBatches(*this, block_tree_db,
-                                         batch_newdb, batch_olddb,
-                                         prev_key, key);
-            prev_key = key;
-        }
-    }
-
-    // If these final DB batches complete the migration, write the best block
-    // hash marker to the new database and delete from the old one. This signals
-    // that the former is fully caught up to that point in the blockchain and
-    // that all txindex entries have been removed from the latter.
-    if (!interrupted) {
-        batch_olddb.Erase(DB_TXINDEX_BLOCK);
-        batch_newdb.Write(DB_BEST_BLOCK, locator);
-    }
-
-    WriteTxIndexMigrationBatches(*this, block_tree_db,
-                                 batch_newdb, batch_olddb,
-                                 begin_key, key);
-
-    if (interrupted) {
-        LogPrintf("[CANCELLED].\n");
-        return false;
-    }
-
-    uiInterface.ShowProgress("", 100, false);
-
-    LogPrintf("[DONE].\n");
-    return true;
-}
@@ -562,8 +562,17 @@ void CTxMemPool::removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMem
 
 void CTxMemPool::removeConflicts(const CTransaction &tx)
 {
-    // Remove transactions which depend on inputs of tx, recursively
     LOCK(cs);
+    removeSpendConflicts(tx);
+
+    /* Remove conflicting name registrations.  */
+    names.removeConflicts (tx);
+}
+
+void CTxMemPool::removeSpendConflicts(const CTransaction &tx)
+{
+    // Remove transactions which depend on inputs of tx, recursively
+    AssertLockHeld(cs);
     for (const CTxIn &txin : tx.vin) {
         auto it = mapNextTx.find(txin.prevout);
         if (it != mapNextTx.end()) {
@@ -575,9 +584,6 @@ void CTxMemPool::removeConflicts(const CTransaction &tx)
             }
         }
     }
-
-    /* Remove conflicting name registrations.  */
-    names.removeConflicts (tx);
 }
 
 /**
@@ -605,9 +611,11 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
             stage.insert(it);
             RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
         }
-        removeConflicts(*tx);
+        removeSpendConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
+    /* Name conflicts are checked for the whole block at once.  */
+    names.removeConflicts(vtx);
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
 }
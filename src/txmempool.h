@@ -718,6 +718,35 @@ public:
         return names.checkTx (tx);
     }
 
+    /**
+     * Quickly check name updates in a tx against the confirmed name data
+     * (see CNameMemPool::checkUpdateFast).
+     * @param tx The tx that should be added.
+     * @param tip The coins view of the current chain tip.
+     * @return False if the tx is certainly invalid.
+     */
+    inline bool
+    checkNameUpdateFast (const CTransaction& tx, const CCoinsView& tip) const
+    {
+        AssertLockHeld(cs);
+        return names.checkUpdateFast (tx, tip);
+    }
+
+    /**
+     * Look up the confirmed data of a name, using a per-tip cache.
+     * @param name The name to look up.
+     * @param tip The coins view of the current chain tip.
+     * @param data Put the name's data here.
+     * @return True iff the name exists.
+     */
+    inline bool
+    getConfirmedName (const valtype& name, const CCoinsView& tip,
+                      CNameData& data) const
+    {
+        AssertLockHeld(cs);
+        return names.getConfirmedName (name, tip, data);
+    }
+
     CTransactionRef get(const uint256& hash) const;
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
@@ -754,6 +783,8 @@ private:
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Remove transactions that spend the same inputs as tx, recursively. */
+    void removeSpendConflicts(const CTransaction &tx) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /** Before calling removeUnchecked for a given transaction,
      *  UpdateForRemoveFromMempool must be called on the entire (dependent) set
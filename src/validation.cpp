@@ -23,6 +23,7 @@
 #include <hash.h>
 #include <index/txindex.h>
 #include <init.h>
+#include <names/index.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -243,6 +244,7 @@ arith_uint256 nMinimumChainWork;
 
 CWaitableCriticalSection mut_currentState;
 CConditionVariable cv_stateChange;
+uint256 hashCurrentState;
 
 CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE);
 CAmount maxTxFee = DEFAULT_TRANSACTION_MAXFEE;
@@ -635,8 +637,15 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 // first-seen mempool behavior should be checking all
                 // unconfirmed ancestors anyway; doing otherwise is hopelessly
                 // insecure.
+                //
+                // A pending move can always be superseded by a new move of
+                // the same player, subject to the usual fee rules below.
                 bool fReplacementOptOut = true;
-                if (fEnableReplacement)
+                if (fEnableReplacement && IsNameUpdateReplacement(tx, *ptxConflicting))
+                {
+                    fReplacementOptOut = false;
+                }
+                else if (fEnableReplacement)
                 {
                     for (const CTxIn &_txin : ptxConflicting->vin)
                     {
@@ -659,6 +668,11 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
     if (!pool.checkNameOps(tx))
         return false;
 
+    /* Reject moves built on a stale state early, before looking up the
+       inputs.  Otherwise they would end up as orphans.  */
+    if (!pool.checkNameUpdateFast(tx, *pcoinsTip))
+        return state.Invalid(false, REJECT_INVALID, "bad-txns-name-update-stale");
+
     {
         CCoinsView dummy;
         CCoinsViewCache view(&dummy);
@@ -701,7 +715,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             {
                 const valtype& name = nameOp.getOpName();
                 CNameData data;
-                if (view.GetName(name, data))
+                if (pool.getConfirmedName(name, *pcoinsTip, data))
                     view.SetName(name, data, false);
             }
         }
@@ -1241,11 +1255,8 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return ReadBlockOrHeader(block, pindex, consensusParams);
 }
 
-bool ReadBlockFromDisk(CBlock& block, std::vector<CTransactionRef>& vGameTx, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadGameTxFromDisk(std::vector<CTransactionRef>& vGameTx, const CBlockIndex* pindex)
 {
-    if (!ReadBlockFromDisk(block, pindex, consensusParams))
-        return false;
-
     /* If this is the genesis block, skip reading the undo file as it does
        not exist.  There are no game tx in the genesis block.  */
     if (pindex->nHeight == 0) {
@@ -1253,8 +1264,21 @@ bool ReadBlockFromDisk(CBlock& block, std::vector<CTransactionRef>& vGameTx, con
         return true;
     }
 
-    /* Read also the game tx array from the undo file.  */
-    CAutoFile undo(OpenUndoFile(pindex->GetUndoPos(), true), SER_DISK, CLIENT_VERSION);
+    /* Blocks connected by recent versions have their game tx stored in the
+       block tree DB, which avoids a random read of the undo file.  */
+    CDiskBlockPos undoPos;
+    {
+        LOCK(cs_main);
+        if (pindex->nStatus & BLOCK_HAVE_GAMETX) {
+            if (!pblocktree->ReadGameTx(pindex->GetBlockHash(), vGameTx))
+                return error("%s: failed to read game tx for %s", __func__, pindex->GetBlockHash().ToString());
+            return true;
+        }
+        undoPos = pindex->GetUndoPos();
+    }
+
+    /* Otherwise read the game tx array from the undo file.  */
+    CAutoFile undo(OpenUndoFile(undoPos, true), SER_DISK, CLIENT_VERSION);
     if (undo.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
     try {
@@ -1265,6 +1289,13 @@ bool ReadBlockFromDisk(CBlock& block, std::vector<CTransactionRef>& vGameTx, con
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, std::vector<CTransactionRef>& vGameTx, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    if (!ReadBlockFromDisk(block, pindex, consensusParams))
+        return false;
+    return ReadGameTxFromDisk(vGameTx, pindex);
+}
+
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     return ReadBlockOrHeader(block, pindex, consensusParams);
@@ -1867,6 +1898,16 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
         setDirtyBlockIndex.insert(pindex);
     }
 
+    // Store the game transactions also separately, so that they can be read
+    // without the undo data.  This is done as well for blocks whose undo
+    // data was written before game transactions were stored like this.
+    if (!(pindex->nStatus & BLOCK_HAVE_GAMETX)) {
+        if (!pblocktree->WriteGameTx(pindex->GetBlockHash(), blockundo.vgametx))
+            return AbortNode(state, "Failed to write game transactions");
+        pindex->nStatus |= BLOCK_HAVE_GAMETX;
+        setDirtyBlockIndex.insert(pindex);
+    }
+
     return true;
 }
 
@@ -2209,6 +2250,9 @@ CChainState::ConnectBlockWithGameTx(const CBlock& block, CValidationState& state
     if (fJustCheck)
         return true;
 
+    if (!isGenesis)
+        CheckNameChanges(view, block.GetHash(), stepResult.GetKilledPlayers());
+
     /* Skip this step for the genesis block.  */
     if (!isGenesis && !WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
@@ -2392,6 +2436,9 @@ void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainPar
         g_best_block_cv.notify_all();
     }
 
+    // Let the game db know which states belong to the recent main chain.
+    pgameDb->setTip(pindexNew);
+
     std::vector<std::string> warningMessages;
     if (!IsInitialBlockDownload())
     {
@@ -2465,6 +2512,12 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
         if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        /* Undoing the block restores the names of the players it changed,
+           so checking the touched names covers them.  */
+        if (pindexDelete->pprev)
+            CheckNameChanges(view, pindexDelete->pprev->GetBlockHash(), PlayerSet());
+        if (pnameIndex)
+            pnameIndex->apply(view.GetNameCache(), pindexDelete->nHeight - 1);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -2637,6 +2690,8 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        if (pnameIndex)
+            pnameIndex->apply(view.GetNameCache(), pindexNew->nHeight);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -4139,6 +4194,7 @@ bool LoadChainTip(const CChainParams& chainparams)
         return false;
     }
     chainActive.SetTip(pindex);
+    pgameDb->setTip(pindex);
 
     g_chainstate.PruneBlockIndexCandidates();
 
@@ -4419,7 +4475,7 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
             // Reduce validity
             pindexIter->nStatus = std::min<unsigned int>(pindexIter->nStatus & BLOCK_VALID_MASK, BLOCK_VALID_TREE) | (pindexIter->nStatus & ~BLOCK_VALID_MASK);
             // Remove have-data flags.
-            pindexIter->nStatus &= ~(BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO);
+            pindexIter->nStatus &= ~(BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO | BLOCK_HAVE_GAMETX);
             // Remove storage location.
             pindexIter->nFile = 0;
             pindexIter->nDataPos = 0;
@@ -216,9 +216,14 @@ extern uint256 hashAssumeValid;
 /** Minimum work we will assume exists on some valid chain. */
 extern arith_uint256 nMinimumChainWork;
 
-/* Lock and condition variable for game_waitforchange.  */
+/* Lock and condition variable for game_waitforchange.  hashCurrentState is
+   the best block as last notified, and is guarded by mut_currentState.
+   Waiters use it instead of chainActive, since block notifications are sent
+   while holding cs_main:  cs_main must not be locked while mut_currentState
+   is held.  */
 extern CWaitableCriticalSection mut_currentState;
 extern CConditionVariable cv_stateChange;
+extern uint256 hashCurrentState;
 
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
@@ -436,6 +441,10 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, std::vector<CTransactionRef>& vGameTx,
                        const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read only the game transactions of a block.  This works also for pruned
+ *  blocks if they were connected with a version storing game transactions
+ *  in the block tree database.  */
+bool ReadGameTxFromDisk(std::vector<CTransactionRef>& vGameTx, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 Daniel Kraft
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Test game_previewstep, which predicts the next game state from the
+# pending moves in the mempool.
+
+from test_framework.game import GameTestFramework
+from test_framework.util import *
+
+class GamePreviewStepTest (GameTestFramework):
+
+  def set_test_params (self):
+    self.setup_name_test ([[]] * 1)
+
+  def run_test (self):
+    node = self.nodes[0]
+
+    self.register (0, "mover", 0)
+    self.register (0, "idle", 1)
+    self.advance (0, 1)
+
+    # Without pending moves, the same players are still there.  The diff
+    # contains only changed entries, with the full state of changed players.
+    state = node.game_getstate ()
+    preview = node.game_previewstep ()
+    assert_equal (preview["hashPrev"], node.getbestblockhash ())
+    assert_equal (preview["moves"], 0)
+    assert_equal (preview["state"]["height"], state["height"] + 1)
+    assert_equal (sorted (preview["state"]["players"].keys ()),
+                  sorted (state["players"].keys ()))
+    diff = node.game_previewstep (True)["diff"]
+    assert_equal (diff["height"], state["height"] + 1)
+    for name, p in diff["players"].items ():
+      assert_equal (p, preview["state"]["players"][name])
+      assert p != state["players"][name]
+
+    # A pending move is applied to the predicted state.
+    self.get (0, "mover", 0).move ([10, 10])
+    self.issueMoves ()
+    preview = node.game_previewstep ()
+    assert_equal (preview["moves"], 1)
+    diff = node.game_previewstep (True)["diff"]
+    assert "mover" in diff["players"]
+    assert_equal (diff["players"]["mover"], preview["state"]["players"]["mover"])
+
+    # The prediction matches the state after the next block.
+    self.advance (0, 1)
+    state = node.game_getstate ()
+    assert_equal (state["height"], preview["state"]["height"])
+    predicted = preview["state"]["players"]["mover"]["characters"]["0"]
+    actual = state["players"]["mover"]["characters"]["0"]
+    assert_equal ([actual["x"], actual["y"]], [predicted["x"], predicted["y"]])
+    assert_equal (actual["wp"], predicted["wp"])
+
+    # The preview follows the new tip.
+    preview = node.game_previewstep (True)
+    assert_equal (preview["hashPrev"], node.getbestblockhash ())
+    assert_equal (preview["moves"], 0)
+
+if __name__ == '__main__':
+  GamePreviewStepTest ().main ()
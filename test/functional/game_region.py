@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 Daniel Kraft
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Test the player and region queries game_getplayerstates and
+# game_getregion against the full game state.
+
+from test_framework.game import GameTestFramework
+from test_framework.util import *
+
+class GameRegionTest (GameTestFramework):
+
+  def set_test_params (self):
+    self.setup_name_test ([[]] * 1)
+
+  def inRegion (self, pos, a, b):
+    return (min (a[0], b[0]) <= pos[0] <= max (a[0], b[0])
+            and min (a[1], b[1]) <= pos[1] <= max (a[1], b[1]))
+
+  def run_test (self):
+    node = self.nodes[0]
+
+    self.register (0, "top", 0)
+    self.register (0, "bottom", 2)
+    self.advance (0, 1)
+
+    state = node.game_getstate ()
+    blkhash = node.getbestblockhash ()
+
+    # Batch lookup of players returns the same as single lookups.
+    players = node.game_getplayerstates (["top", "bottom", "nobody"])
+    assert_equal (players["top"], node.game_getplayerstate ("top"))
+    assert_equal (players["bottom"], state["players"]["bottom"])
+    assert_equal (players["nobody"], None)
+    assert_raises_rpc_error (-5, "No such player",
+                             node.game_getplayerstate, "nobody")
+
+    # The whole map contains everything in the full state.
+    region = node.game_getregion ([0, 0], [501, 501])
+    assert_equal (region["height"], state["height"])
+    assert_equal (region["hashBlock"], blkhash)
+    assert_equal (region["banks"], state["banks"])
+    assert_equal (region["hearts"], state["hearts"])
+    assert_equal (region["loot"], state["loot"])
+    numChars = sum ([len (p["characters"])
+                     for p in state["players"].values ()])
+    assert_equal (len (region["characters"]), numChars)
+    for c in region["characters"]:
+      player = state["players"][c["player"]]
+      assert_equal (c["color"], player["color"])
+      expected = player["characters"][str (c["index"])]
+      for key, val in expected.items ():
+        assert_equal (c[key], val)
+
+    # Query a corner with the corners given in reverse order.
+    a = [250, 0]
+    b = [0, 250]
+    region = node.game_getregion (a, b, blkhash)
+    expected = []
+    for name, p in state["players"].items ():
+      for ind, c in p["characters"].items ():
+        if self.inRegion ([c["x"], c["y"]], a, b):
+          expected.append ([name, int (ind)])
+    found = [[c["player"], c["index"]] for c in region["characters"]]
+    assert_equal (sorted (found), sorted (expected))
+    for bank in region["banks"]:
+      assert self.inRegion ([bank["x"], bank["y"]], a, b)
+    assert_equal (len (region["banks"]),
+                  len ([b0 for b0 in state["banks"]
+                        if self.inRegion ([b0["x"], b0["y"]], a, b)]))
+
+    # The crown (in the middle of the map) is only returned if it is
+    # in the region.
+    crown = [state["crown"]["x"], state["crown"]["y"]]
+    region = node.game_getregion (crown, crown)
+    assert_equal (region["crown"], state["crown"])
+    assert "crown" not in node.game_getregion ([0, 0], [1, 1])
+
+    assert_raises_rpc_error (-8, "invalid coordinate",
+                             node.game_getregion, [0], [1, 1])
+
+if __name__ == '__main__':
+  GameRegionTest ().main ()
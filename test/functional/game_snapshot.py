@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 Daniel Kraft
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Test round-tripping game state snapshots with dumpgamestate and
+# loadgamestate.
+
+from test_framework.game import GameTestFramework
+from test_framework.util import *
+
+import os
+
+class GameSnapshotTest (GameTestFramework):
+
+  def set_test_params (self):
+    self.setup_name_test ([[]] * 2)
+
+  def run_test (self):
+    # Create a game state with a player in it.
+    self.register (0, "me", 0)
+    self.advance (0, 1)
+    me = self.get (0, "me", 0)
+    me.move ([10, 10])
+    self.advance (0, 1)
+    self.sync_all ()
+
+    blkhash = self.nodes[0].getbestblockhash ()
+    state = self.nodes[0].game_getstate ()
+
+    # Dump the state from node 0.
+    path = os.path.join (self.options.tmpdir, "gamestate.dat")
+    dump = self.nodes[0].dumpgamestate (path)
+    assert_equal (dump['blockhash'], blkhash)
+    assert_equal (dump['height'], self.nodes[0].getblockcount ())
+    assert_equal (dump['path'], path)
+    assert os.path.isfile (path)
+
+    # Dumping again to the same file fails.
+    assert_raises_rpc_error (-8, "already exists",
+                             self.nodes[0].dumpgamestate, path)
+
+    # Loading with a wrong expected hash fails.
+    assert_raises_rpc_error (-25, "does not match the expected hash",
+                             self.nodes[1].loadgamestate, path, "00" * 32)
+
+    # Load the snapshot into node 1 and verify the state.
+    load = self.nodes[1].loadgamestate (path, dump['hash'])
+    assert_equal (load, {
+      "blockhash": dump['blockhash'],
+      "height": dump['height'],
+      "hash": dump['hash'],
+    })
+    assert_equal (self.nodes[1].game_getstate (blkhash), state)
+
+    # The game continues from there on both nodes.
+    me = self.get (0, "me", 0)
+    me.move ([20, 20])
+    self.advance (0, 1)
+    self.sync_all ()
+    assert_equal (self.nodes[0].game_getstate (),
+                  self.nodes[1].game_getstate ())
+
+    # A corrupted snapshot is rejected.
+    with open (path, "r+b") as f:
+      f.seek (-40, os.SEEK_END)
+      byte = f.read (1)
+      f.seek (-40, os.SEEK_END)
+      f.write (bytes ([byte[0] ^ 0xFF]))
+    assert_raises_rpc_error (-22, "hash commitment",
+                             self.nodes[1].loadgamestate, path)
+
+if __name__ == '__main__':
+  GameSnapshotTest ().main ()
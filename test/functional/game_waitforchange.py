@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 Daniel Kraft
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Test game_waitforchange with full states and diffs.
+
+from test_framework.game import GameTestFramework
+from test_framework.util import *
+
+import threading
+import time
+
+class GameWaitForChangeTest (GameTestFramework):
+
+  def set_test_params (self):
+    # Use fewer RPC threads than waiting clients below.
+    self.setup_name_test ([["-rpcthreads=2"]])
+
+  def run_test (self):
+    node = self.nodes[0]
+
+    self.register (0, "mover", 0)
+    self.register (0, "other", 1)
+    self.advance (0, 1)
+    oldHash = node.getbestblockhash ()
+    oldState = node.game_getstate ()
+
+    self.get (0, "mover", 0).move ([10, 10])
+    self.advance (0, 1)
+    state = node.game_getstate ()
+
+    # With an old block hash, the call returns the current state right away.
+    assert_equal (node.game_waitforchange (oldHash), state)
+    assert_equal (node.game_waitforchange (oldHash, False), state)
+
+    # The diff contains the changed players and the new block hash, which
+    # is used as token for the next call.
+    diff = node.game_waitforchange (oldHash, True)
+    assert_equal (diff["hashBlock"], node.getbestblockhash ())
+    assert_equal (diff["height"], state["height"])
+    assert_equal (diff["players"]["mover"], state["players"]["mover"])
+    for name, p in diff["players"].items ():
+      assert p != oldState["players"][name]
+    for key, val in state.items ():
+      if key != "players" and key not in diff:
+        assert_equal (val, oldState[key])
+
+    # Waiting clients all receive the next block's state.  They do not block
+    # the RPC worker threads while waiting.
+    results = [None] * 6
+    def wait (ind, useDiff):
+      rpc = get_rpc_proxy (node.url, 0, timeout=600)
+      results[ind] = rpc.game_waitforchange (state["hashBlock"], useDiff)
+    threads = [threading.Thread (target=wait, args=(i, i > 0))
+               for i in range (len (results))]
+    for t in threads:
+      t.start ()
+    time.sleep (1)
+    assert_equal (node.getblockcount (), state["height"])
+    assert_equal (results, [None] * len (results))
+    self.advance (0, 1)
+    for t in threads:
+      t.join ()
+    newState = node.game_getstate ()
+    assert_equal (results[0], newState)
+    for r in results[2:]:
+      assert_equal (r, results[1])
+    assert_equal (results[1]["hashBlock"], newState["hashBlock"])
+
+if __name__ == '__main__':
+  GameWaitForChangeTest ().main ()
@@ -305,6 +305,9 @@ class RESTTest (BitcoinTestFramework):
         self.log.info("Test the /name URI")
         self.name_tests()
 
+        self.log.info("Test the /game URIs")
+        self.game_tests()
+
     def name_tests(self):
         """
         Run REST tests specific to names.
@@ -351,5 +354,34 @@ class RESTTest (BitcoinTestFramework):
                                           req_type=ReqType.BIN,
                                           ret_type=RetType.OBJ)
 
+    def game_tests(self):
+        """
+        Run REST tests for the game state.
+        """
+
+        self.nodes[0].name_register("rest player", '{"color":1}')
+        self.nodes[0].generate(1)
+        bb_hash = self.nodes[0].getbestblockhash()
+
+        # The JSON formats match the RPC interface.
+        state = self.test_rest_request('/game/state/' + bb_hash)
+        assert_equal(state, self.nodes[0].game_getstate())
+        query = '/game/player/' + bb_hash + '/' + urllib.parse.quote_plus("rest player")
+        player = self.test_rest_request(query)
+        assert_equal(player, self.nodes[0].game_getplayerstate("rest player"))
+
+        # Binary and hex formats agree.
+        for query in ['/game/state/' + bb_hash, query]:
+            binData = self.test_rest_request(query, req_type=ReqType.BIN, ret_type=RetType.BYTES)
+            hexData = self.test_rest_request(query, req_type=ReqType.HEX, ret_type=RetType.BYTES)
+            assert_equal(binascii.hexlify(binData) + b"\n", hexData)
+        assert b"rest player" in binData
+
+        # Errors for unknown blocks and players.
+        self.test_rest_request('/game/state/' + '0' * 64, status=404, ret_type=RetType.OBJ)
+        self.test_rest_request('/game/state/invalid', status=400, ret_type=RetType.OBJ)
+        self.test_rest_request('/game/player/' + bb_hash + '/nobody', status=404, ret_type=RetType.OBJ)
+        self.test_rest_request('/game/player/' + bb_hash, status=400, ret_type=RetType.OBJ)
+
 if __name__ == '__main__':
     RESTTest().main()
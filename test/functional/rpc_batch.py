@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 Daniel Kraft
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test JSON-RPC batch requests.
+
+Read-only calls of a batch are executed concurrently, all others in order.
+The replies must be in the order of the requests in either case.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+class RPCBatchTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [[], ["-rpcbatchthreads=1"]]
+
+    def run_test(self):
+        for node in self.nodes:
+            self._test_order(node)
+            self._test_mixed(node)
+
+    def _test_order(self, node):
+        self.log.info("Testing the order of batch replies...")
+        height = node.getblockcount()
+        requests = [node.getblockhash.get_request(h % (height + 2)) for h in range(50)]
+        replies = node.batch(requests)
+        assert_equal(len(replies), len(requests))
+        for h, (req, rep) in enumerate(zip(requests, replies)):
+            assert_equal(rep["id"], req["id"])
+            if h % (height + 2) > height:
+                assert_equal(rep["result"], None)
+                assert_equal(rep["error"]["code"], -8)
+            else:
+                assert_equal(rep["error"], None)
+                assert_equal(rep["result"], node.getblockhash(h % (height + 2)))
+
+    def _test_mixed(self, node):
+        self.log.info("Testing calls that depend on earlier ones in the batch...")
+        address = node.getnewaddress()
+        requests = [
+            node.getblockcount.get_request(),
+            node.generatetoaddress.get_request(1, address),
+            node.getblockcount.get_request(),
+            node.getbestblockhash.get_request(),
+        ]
+        replies = node.batch(requests)
+        assert_equal([rep["id"] for rep in replies], [req["id"] for req in requests])
+        assert_equal(replies[2]["result"], replies[0]["result"] + 1)
+        assert_equal(replies[3]["result"], replies[1]["result"][0])
+
+
+if __name__ == '__main__':
+    RPCBatchTest().main()
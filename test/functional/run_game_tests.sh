@@ -27,6 +27,18 @@ echo "\nGame mempool cleanup..."
 echo "\nGame miner taxes..."
 ./game_minertaxes.py
 
+echo "\nGame state snapshots..."
+./game_snapshot.py
+
+echo "\nGame state queries..."
+./game_region.py
+
+echo "\nGame step preview..."
+./game_previewstep.py
+
+echo "\nGame state notifications..."
+./game_waitforchange.py
+
 echo "\nDual-algo..."
 ./mining_dualalgo.py
 
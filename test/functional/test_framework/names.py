@@ -113,6 +113,19 @@ class NameTestFramework (BitcoinTestFramework):
 
     assert_equal (valuesFound, values)
 
+    # Verify also that paging through the history works.
+    for start in range (len (values) + 1):
+      for count in range (1, len (values) + 1):
+        page = self.nodes[ind].name_history (name, start, count)
+        assert_equal ([e['value'] for e in page],
+                      values[start:start + count])
+
+    # Large pages must not overflow the end of the requested range.
+    maxInt = 2**31 - 1
+    page = self.nodes[ind].name_history (name, 1, maxInt)
+    assert_equal ([e['value'] for e in page], values[1:])
+    assert_equal (self.nodes[ind].name_history (name, maxInt, maxInt), [])
+
   def pendingTxid (self, ind, name):
     """
     Look through name_pending for the name and return the corresponding txid.
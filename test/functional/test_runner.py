@@ -141,6 +141,7 @@ BASE_SCRIPTS = [
     'wallet_fallbackfee.py',
     'feature_minchainwork.py',
     'rpc_getblockstats.py',
+    'rpc_batch.py',
     'p2p_fingerprint.py',
     'feature_uacomment.py',
     'p2p_unrequested_blocks.py',
@@ -178,6 +179,10 @@ BASE_SCRIPTS = [
     'game_kills.py',
     'game_mempool.py',
     'game_minertaxes.py',
+    'game_snapshot.py',
+    'game_region.py',
+    'game_previewstep.py',
+    'game_waitforchange.py',
 
     # Other new tests for Huntercoin.
     'rpc_getstatsforheight.py',